@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Array of values in chunks of 2^CHUNK_BITS that copies of the array share. A copy costs
+// a pointer per chunk, and a change copies the one chunk it touches if another copy still
+// holds it. Reads never change a chunk, so a copy may be read from other threads while
+// this one is changed. Only the values below Size() are meaningful.
+template <typename T, size_t CHUNK_BITS>
+class ChunkedVector {
+public:
+    static constexpr size_t CHUNK_SIZE = size_t{ 1 } << CHUNK_BITS;
+
+    size_t Size() const noexcept {
+        return size_;
+    }
+
+    bool Empty() const noexcept {
+        return size_ == 0;
+    }
+
+    const T& operator[](size_t index) const noexcept {
+        return chunks_[index >> CHUNK_BITS]->values[index & (CHUNK_SIZE - 1)];
+    }
+
+    const T& Back() const noexcept {
+        return (*this)[size_ - 1];
+    }
+
+    // the value to change in place, its chunk is copied first if it is shared
+    T& Mutable(size_t index);
+
+    void PushBack(T value);
+    void PopBack();
+    void Resize(size_t size, const T& value = T{});
+
+private:
+    struct Chunk {
+        T values[CHUNK_SIZE];
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+
+    Chunk& MutableChunk(size_t chunk_index);
+};
+
+template <typename T, size_t CHUNK_BITS>
+T& ChunkedVector<T, CHUNK_BITS>::Mutable(size_t index) {
+    return MutableChunk(index >> CHUNK_BITS).values[index & (CHUNK_SIZE - 1)];
+}
+
+template <typename T, size_t CHUNK_BITS>
+void ChunkedVector<T, CHUNK_BITS>::PushBack(T value) {
+    if (size_ == chunks_.size() * CHUNK_SIZE) {
+        chunks_.push_back(std::make_shared<Chunk>());
+    }
+    ++size_;
+    Mutable(size_ - 1) = std::move(value);
+}
+
+template <typename T, size_t CHUNK_BITS>
+void ChunkedVector<T, CHUNK_BITS>::PopBack() {
+    --size_;
+    if (size_ == (chunks_.size() - 1) * CHUNK_SIZE) {
+        chunks_.pop_back();
+    } else {
+        // releases what the value holds
+        Mutable(size_) = T{};
+    }
+}
+
+template <typename T, size_t CHUNK_BITS>
+void ChunkedVector<T, CHUNK_BITS>::Resize(size_t size, const T& value) {
+    while (size_ > size) {
+        PopBack();
+    }
+    while (size_ < size) {
+        PushBack(value);
+    }
+}
+
+template <typename T, size_t CHUNK_BITS>
+typename ChunkedVector<T, CHUNK_BITS>::Chunk& ChunkedVector<T, CHUNK_BITS>::MutableChunk(size_t chunk_index) {
+    std::shared_ptr<Chunk>& chunk = chunks_[chunk_index];
+    if (chunk.use_count() != 1) {
+        chunk = std::make_shared<Chunk>(*chunk);
+    } else {
+        // the copies that held the chunk may have just dropped it, their reads come first
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *chunk;
+}
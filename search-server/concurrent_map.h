@@ -1,77 +1,257 @@
 #pragma once
 #include <algorithm>
-#include <cstdlib>
-#include <future>
+#include <cstddef>
+#include <cstdint>
 #include <map>
-#include <numeric>
-#include <random>
-#include <string>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-#include "log_duration.h"
-
+inline uint64_t HashConcurrentKey(uint64_t key)
+{
+    // Fibonacci hashing spreads consecutive keys such as document slots over the whole table
+    return key * 0x9E3779B97F4A7C15ull;
+}
 
-using namespace std::string_literals;
+inline size_t RoundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+    {
+        result *= 2;
+    }
+    return result;
+}
 
+// Map from integer keys sharded by key hash. Every shard is an open-addressed table
+// guarded by its own mutex, the default shard count follows the number of hardware threads.
 template <typename Key, typename Value>
-class ConcurrentMap 
+class ConcurrentMap
 {
-private:
-
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
 
-    struct Bucket
+    struct Access;
+
+private:
+    // linear probing table, erased cells are marked and reused by the next insert
+    class FlatTable
     {
-        std::mutex mtx;
-        std::map<Key, Value> map;
+    public:
+        Value& operator[](const Key& key)
+        {
+            if ((used_count_ + 1) * 4 > keys_.size() * 3)
+            {
+                Rehash(std::max<size_t>(16, RoundUpToPowerOfTwo((size_ + 1) * 2)));
+            }
+            size_t index = Find(key);
+            if (states_[index] == FULL)
+            {
+                return values_[index];
+            }
+            // the key is absent, take the first erased cell on its probe path if there is one
+            size_t target = index;
+            for (size_t probe = Home(key); probe != index; probe = (probe + 1) & (keys_.size() - 1))
+            {
+                if (states_[probe] == ERASED)
+                {
+                    target = probe;
+                    break;
+                }
+            }
+            if (states_[target] == EMPTY)
+            {
+                ++used_count_;
+            }
+            states_[target] = FULL;
+            keys_[target] = key;
+            values_[target] = Value{};
+            ++size_;
+            return values_[target];
+        }
+
+        void Erase(const Key& key)
+        {
+            if (keys_.empty())
+            {
+                return;
+            }
+            const size_t index = Find(key);
+            if (states_[index] == FULL)
+            {
+                states_[index] = ERASED;
+                values_[index] = Value{};
+                --size_;
+            }
+        }
+
+        template <typename Function>
+        void ForEach(Function function)
+        {
+            for (size_t i = 0; i < keys_.size(); ++i)
+            {
+                if (states_[i] == FULL)
+                {
+                    function(keys_[i], values_[i]);
+                }
+            }
+        }
+
+        size_t Size() const noexcept
+        {
+            return size_;
+        }
 
-        void Erase(Key key)
+        void Clear()
         {
-            map.erase(key);
+            keys_.clear();
+            values_.clear();
+            states_.clear();
+            size_ = 0;
+            used_count_ = 0;
+        }
+
+    private:
+        enum State : uint8_t
+        {
+            EMPTY,
+            FULL,
+            ERASED
+        };
+
+        std::vector<Key> keys_;
+        std::vector<Value> values_;
+        std::vector<uint8_t> states_;
+        size_t size_ = 0;
+        // full and erased cells, an insert must leave at least one empty cell to end probing
+        size_t used_count_ = 0;
+
+        size_t Home(const Key& key) const noexcept
+        {
+            return static_cast<size_t>(HashConcurrentKey(static_cast<uint64_t>(key)) >> 32) & (keys_.size() - 1);
+        }
+
+        // the cell holding the key, or the empty cell that ends its probe path
+        size_t Find(const Key& key) const noexcept
+        {
+            size_t index = Home(key);
+            while (states_[index] != EMPTY && !(states_[index] == FULL && keys_[index] == key))
+            {
+                index = (index + 1) & (keys_.size() - 1);
+            }
+            return index;
+        }
+
+        void Rehash(size_t capacity)
+        {
+            std::vector<Key> keys(capacity);
+            std::vector<Value> values(capacity);
+            std::vector<uint8_t> states(capacity, EMPTY);
+            std::swap(keys, keys_);
+            std::swap(values, values_);
+            std::swap(states, states_);
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                if (states[i] == FULL)
+                {
+                    const size_t index = Find(keys[i]);
+                    states_[index] = FULL;
+                    keys_[index] = keys[i];
+                    values_[index] = std::move(values[i]);
+                }
+            }
+            used_count_ = size_;
         }
     };
 
+    struct Shard
+    {
+        std::mutex mtx;
+        FlatTable table;
+    };
 
-    struct Access 
-{
+public:
+    struct Access
+    {
         std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mtx)
-            , ref_to_value(bucket.map[key]) 
+        Access(const Key& key, Shard& shard)
+            : guard(shard.mtx)
+            , ref_to_value(shard.table[key])
         {
         }
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : all_parts_(bucket_count) 
+    ConcurrentMap()
+        : ConcurrentMap(std::max(1u, std::thread::hardware_concurrency()) * 4)
     {
     }
 
-    Access operator[](const Key& key) 
+    explicit ConcurrentMap(size_t shard_count)
+        : all_parts_(RoundUpToPowerOfTwo(std::max<size_t>(shard_count, 1)))
     {
-        auto& bucket = all_parts_[static_cast<uint64_t>(key) % all_parts_.size()];
-        return { key, bucket };
+        while ((size_t{ 1 } << shard_bits_) < all_parts_.size())
+        {
+            ++shard_bits_;
+        }
     }
 
-    void Erase(Key key)
+    Access operator[](const Key& key)
     {
-        all_parts_[static_cast<uint64_t>(key) % all_parts_.size()].Erase(key);
+        return { key, GetShard(key) };
+    }
+
+    void Erase(const Key& key)
+    {
+        Shard& shard = GetShard(key);
+        std::lock_guard guard(shard.mtx);
+        shard.table.Erase(key);
     }
 
     std::map<Key, Value> BuildOrdinaryMap()
     {
         std::map<Key, Value> result;
-        for (auto& [mtx, map] : all_parts_) 
+        for (Shard& shard : all_parts_)
         {
-            std::lock_guard g(mtx);
-            result.insert(map.begin(), map.end());
+            std::lock_guard guard(shard.mtx);
+            shard.table.ForEach([&result](const Key& key, Value& value)
+                {
+                    result.emplace(key, value);
+                });
+        }
+        return result;
+    }
+
+    // Moves all items out in no particular order and leaves the map empty.
+    std::vector<std::pair<Key, Value>> MoveToVector()
+    {
+        std::vector<std::pair<Key, Value>> result;
+        for (Shard& shard : all_parts_)
+        {
+            std::lock_guard guard(shard.mtx);
+            shard.table.ForEach([&result](const Key& key, Value& value)
+                {
+                    result.emplace_back(key, std::move(value));
+                });
+            shard.table.Clear();
         }
         return result;
     }
 
 private:
-    std::vector<Bucket> all_parts_;
+    std::vector<Shard> all_parts_;
+    int shard_bits_ = 0;
+
+    Shard& GetShard(const Key& key)
+    {
+        if (shard_bits_ == 0)
+        {
+            return all_parts_[0];
+        }
+        // the top bits choose the shard, the table inside uses the middle ones
+        return all_parts_[HashConcurrentKey(static_cast<uint64_t>(key)) >> (64 - shard_bits_)];
+    }
 };
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document 
 {
@@ -25,3 +27,12 @@ enum class DocumentStatus
     BANNED,
     REMOVED
 };
+
+// Input record of SearchServer::AddDocuments, the text has to outlive the call only
+struct NewDocument 
+{
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
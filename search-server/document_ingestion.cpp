@@ -0,0 +1,337 @@
+#include "document_ingestion.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+using namespace std::string_literals;
+
+namespace {
+
+struct RecordError {
+    size_t line_number;
+    std::string reason;
+};
+
+struct DocumentBatch {
+    // the records of whole lines only, a vector keeps its data in place when moved
+    std::vector<char> block;
+    std::vector<NewDocument> documents;
+    // the line of each document
+    std::vector<size_t> line_numbers;
+    // the malformed records in the block, by line
+    std::vector<RecordError> errors;
+};
+
+// Blocking queue of a fixed capacity: a full queue stops the producer, which is
+// what keeps the reader from running arbitrarily far ahead of the indexing.
+class BatchQueue {
+public:
+    explicit BatchQueue(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1))
+    {
+    }
+
+    // false if the consumer has given up
+    bool Push(DocumentBatch batch) {
+        std::unique_lock lock(mutex_);
+        has_space_.wait(lock, [this]() {
+            return batches_.size() < capacity_ || is_cancelled_;
+        });
+        if (is_cancelled_) {
+            return false;
+        }
+        batches_.push_back(std::move(batch));
+        has_batch_.notify_one();
+        return true;
+    }
+
+    // empty once the queue is closed and drained
+    std::optional<DocumentBatch> Pop() {
+        std::unique_lock lock(mutex_);
+        has_batch_.wait(lock, [this]() {
+            return !batches_.empty() || is_closed_;
+        });
+        if (batches_.empty()) {
+            return std::nullopt;
+        }
+        DocumentBatch batch = std::move(batches_.front());
+        batches_.pop_front();
+        has_space_.notify_one();
+        return batch;
+    }
+
+    void Close(std::exception_ptr error = nullptr) {
+        std::lock_guard guard(mutex_);
+        is_closed_ = true;
+        error_ = error;
+        has_batch_.notify_all();
+    }
+
+    void Cancel() {
+        std::lock_guard guard(mutex_);
+        is_cancelled_ = true;
+        has_space_.notify_all();
+    }
+
+    std::exception_ptr GetError() {
+        std::lock_guard guard(mutex_);
+        return error_;
+    }
+
+    // a consumed batch goes back to the reader, which refills its buffers
+    void Recycle(DocumentBatch batch) {
+        std::lock_guard guard(mutex_);
+        if (free_batches_.size() < capacity_) {
+            free_batches_.push_back(std::move(batch));
+        }
+    }
+
+    DocumentBatch TakeFreeBatch() {
+        std::lock_guard guard(mutex_);
+        if (free_batches_.empty()) {
+            return {};
+        }
+        DocumentBatch batch = std::move(free_batches_.back());
+        free_batches_.pop_back();
+        return batch;
+    }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable has_space_;
+    std::condition_variable has_batch_;
+    std::deque<DocumentBatch> batches_;
+    std::vector<DocumentBatch> free_batches_;
+    bool is_closed_ = false;
+    bool is_cancelled_ = false;
+    std::exception_ptr error_;
+};
+
+std::string_view CutField(std::string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == std::string_view::npos) {
+        throw std::invalid_argument("missing field"s);
+    }
+    const std::string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(std::string_view text, const char* field_name) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc{} || end != text.data() + text.size()) {
+        throw std::invalid_argument("invalid "s + field_name + " '"s + std::string(text) + "'"s);
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(std::string_view text) {
+    if (text == "ACTUAL") {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT") {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED") {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED") {
+        return DocumentStatus::REMOVED;
+    }
+    throw std::invalid_argument("invalid status '"s + std::string(text) + "'"s);
+}
+
+void ParseRecord(std::string_view line, NewDocument& document) {
+    document.id = ParseInt(CutField(line), "id");
+    document.status = ParseStatus(CutField(line));
+    std::string_view ratings = CutField(line);
+    document.ratings.clear();
+    while (!ratings.empty()) {
+        const size_t space = ratings.find(' ');
+        const std::string_view rating = ratings.substr(0, space);
+        ratings.remove_prefix(space == std::string_view::npos ? ratings.size() : space + 1);
+        if (!rating.empty()) {
+            document.ratings.push_back(ParseInt(rating, "rating"));
+        }
+    }
+    document.text = line;
+}
+
+// the documents of batch are refilled from its block, the ratings vectors of its records
+// are reused; a malformed record is left out and described in its errors
+void ParseBlock(size_t first_line_number, DocumentBatch& batch) {
+    std::vector<NewDocument>& documents = batch.documents;
+    size_t document_count = 0;
+    size_t line_number = first_line_number;
+    batch.line_numbers.clear();
+    batch.errors.clear();
+    const std::vector<char>& block = batch.block;
+    std::string_view rest(block.data(), block.size());
+    while (!rest.empty()) {
+        const size_t line_end = rest.find('\n');
+        std::string_view line = rest.substr(0, line_end);
+        rest.remove_prefix(line_end == std::string_view::npos ? rest.size() : line_end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            if (document_count == documents.size()) {
+                documents.emplace_back();
+            }
+            try {
+                ParseRecord(line, documents[document_count]);
+                ++document_count;
+                batch.line_numbers.push_back(line_number);
+            } catch (const std::invalid_argument& e) {
+                batch.errors.push_back({ line_number, e.what() });
+            }
+        }
+        ++line_number;
+    }
+    documents.resize(document_count);
+}
+
+void ReadBatches(std::FILE* input, const IngestionOptions& options, BatchQueue& queue, size_t& byte_count) {
+    std::vector<char> carry;
+    size_t line_number = 1;
+    bool is_end = false;
+    while (!is_end) {
+        DocumentBatch batch = queue.TakeFreeBatch();
+        batch.block.assign(carry.begin(), carry.end());
+        // a record longer than a block keeps the block growing until its line ends
+        size_t line_end = 0;
+        do {
+            const size_t old_size = batch.block.size();
+            batch.block.resize(old_size + options.block_size);
+            const size_t read_size = std::fread(batch.block.data() + old_size, 1, options.block_size, input);
+            batch.block.resize(old_size + read_size);
+            byte_count += read_size;
+            if (read_size < options.block_size) {
+                if (std::ferror(input)) {
+                    throw std::runtime_error("cannot read the document input"s);
+                }
+                is_end = true;
+            }
+            const auto last_newline = std::find(batch.block.rbegin(), batch.block.rend(), '\n');
+            line_end = static_cast<size_t>(batch.block.rend() - last_newline);
+        } while (line_end == 0 && !is_end);
+
+        if (!is_end) {
+            carry.assign(batch.block.begin() + line_end, batch.block.end());
+            batch.block.resize(line_end);
+        }
+        ParseBlock(line_number, batch);
+        line_number += static_cast<size_t>(std::count(batch.block.begin(), batch.block.end(), '\n'));
+        if ((!batch.documents.empty() || !batch.errors.empty()) && !queue.Push(std::move(batch))) {
+            return;
+        }
+    }
+}
+
+// index gets each batch with documents on the calling thread, adds them and returns how
+// many were added; it may describe the ones it leaves out in the errors of the batch
+IngestionStats IngestBatches(std::FILE* input, const std::function<size_t(DocumentBatch&)>& index,
+                             const IngestionOptions& options) {
+    if (options.block_size == 0) {
+        throw std::invalid_argument("the ingestion block size must be positive"s);
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+    const std::string source_name = options.source_name.empty() ? "input"s : options.source_name;
+    IngestionStats stats;
+    BatchQueue queue(options.queue_capacity);
+    std::thread reader([input, &options, &queue, &stats]() {
+        try {
+            ReadBatches(input, options, queue, stats.byte_count);
+            queue.Close();
+        } catch (...) {
+            queue.Close(std::current_exception());
+        }
+    });
+
+    try {
+        while (std::optional<DocumentBatch> batch = queue.Pop()) {
+            if (!batch->documents.empty()) {
+                stats.document_count += index(*batch);
+            }
+            std::stable_sort(batch->errors.begin(), batch->errors.end(), [](const RecordError& lhs, const RecordError& rhs) {
+                return lhs.line_number < rhs.line_number;
+            });
+            for (const RecordError& error : batch->errors) {
+                const std::string report = source_name + ":"s + std::to_string(error.line_number)
+                                           + ": malformed document record, "s + error.reason;
+                if (options.report_malformed_record) {
+                    options.report_malformed_record(report);
+                } else {
+                    std::cerr << report << std::endl;
+                }
+            }
+            stats.skipped_record_count += batch->errors.size();
+            queue.Recycle(std::move(*batch));
+        }
+    } catch (...) {
+        queue.Cancel();
+        reader.join();
+        throw;
+    }
+    reader.join();
+    if (const std::exception_ptr error = queue.GetError()) {
+        std::rethrow_exception(error);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    return stats;
+}
+
+}  // namespace
+
+double IngestionStats::GetDocumentsPerSecond() const {
+    return seconds > 0.0 ? document_count / seconds : 0.0;
+}
+
+double IngestionStats::GetMegabytesPerSecond() const {
+    return seconds > 0.0 ? byte_count / seconds / (1 << 20) : 0.0;
+}
+
+IngestionStats IngestDocuments(std::FILE* input, const std::function<void(const std::vector<NewDocument>&)>& sink,
+                               const IngestionOptions& options) {
+    return IngestBatches(input, [&sink](DocumentBatch& batch) {
+        sink(batch.documents);
+        return batch.documents.size();
+    }, options);
+}
+
+IngestionStats IngestDocuments(SearchServer& search_server, std::FILE* input, const IngestionOptions& options) {
+    return IngestBatches(input, [&search_server](DocumentBatch& batch) {
+        size_t rejected_count = 0;
+        search_server.AddDocuments(std::execution::par, batch.documents,
+            [&batch, &rejected_count](size_t index, const std::string& reason) {
+                batch.errors.push_back({ batch.line_numbers[index], reason });
+                ++rejected_count;
+            });
+        return batch.documents.size() - rejected_count;
+    }, options);
+}
+
+IngestionStats IngestDocuments(SearchServer& search_server, const std::string& path, const IngestionOptions& options) {
+    const std::unique_ptr<std::FILE, int (*)(std::FILE*)> input(std::fopen(path.c_str(), "rb"), std::fclose);
+    if (!input) {
+        throw std::runtime_error("cannot open document file "s + path);
+    }
+    if (!options.source_name.empty()) {
+        return IngestDocuments(search_server, input.get(), options);
+    }
+    IngestionOptions named_options = options;
+    named_options.source_name = path;
+    return IngestDocuments(search_server, input.get(), named_options);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A document file has one record per line with tab-separated fields:
+//     id <TAB> status <TAB> ratings <TAB> text
+// The status is ACTUAL, IRRELEVANT, BANNED or REMOVED, the ratings are integers
+// separated by spaces and may be empty, and the text takes the rest of the line.
+// Empty lines are skipped. A malformed record is reported with its file and line and
+// skipped too, the records around it are still ingested.
+
+struct IngestionOptions {
+    // bytes read at once, a batch of documents holds the records of one such block
+    size_t block_size = size_t{ 4 } << 20;
+    // blocks read ahead of the indexing, the reader waits once that many are queued
+    size_t queue_capacity = 4;
+    // names the input in the reports, the path overload fills it in when empty
+    std::string source_name;
+    // gets "source:line: reason" for every malformed record on the calling thread,
+    // the reports go to std::cerr if unset
+    std::function<void(const std::string&)> report_malformed_record;
+};
+
+struct IngestionStats {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    size_t skipped_record_count = 0;
+    double seconds = 0.0;
+
+    double GetDocumentsPerSecond() const;
+    double GetMegabytesPerSecond() const;
+};
+
+// Reads the records on a separate thread in large blocks and parses them in place, the
+// documents of a batch point into its block. Every batch is passed to sink on the calling
+// thread while the next blocks are read, its memory is reused once sink returns. Read
+// errors and exceptions from sink stop the ingestion and are rethrown.
+IngestionStats IngestDocuments(std::FILE* input, const std::function<void(const std::vector<NewDocument>&)>& sink,
+                               const IngestionOptions& options = {});
+
+// Feeds the batches into AddDocuments with the parallel policy, which tokenizes them concurrently.
+// The documents the server rejects, a repeated id or control characters in the text, are
+// reported and skipped like the malformed records.
+IngestionStats IngestDocuments(SearchServer& search_server, std::FILE* input, const IngestionOptions& options = {});
+IngestionStats IngestDocuments(SearchServer& search_server, const std::string& path, const IngestionOptions& options = {});
@@ -0,0 +1,41 @@
+#include "index_segment.h"
+
+#include <algorithm>
+
+IndexSegment::IndexSegment(int first_slot, int end_slot, int document_count,
+                           std::vector<TermId> term_ids, std::vector<PostingList> postings)
+    : first_slot_(first_slot)
+    , end_slot_(end_slot)
+    , document_count_(document_count)
+    , term_ids_(std::move(term_ids))
+    , postings_(std::move(postings))
+{
+}
+
+int IndexSegment::FirstSlot() const noexcept {
+    return first_slot_;
+}
+
+int IndexSegment::EndSlot() const noexcept {
+    return end_slot_;
+}
+
+int IndexSegment::DocumentCount() const noexcept {
+    return document_count_;
+}
+
+const PostingList* IndexSegment::FindPostings(TermId term_id) const {
+    const auto it = std::lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+    if (it == term_ids_.end() || *it != term_id) {
+        return nullptr;
+    }
+    return &postings_[it - term_ids_.begin()];
+}
+
+IndexSegment IndexSegment::WithCompression(bool compressed) const {
+    IndexSegment result(*this);
+    for (PostingList& postings : result.postings_) {
+        postings.SetCompressed(compressed);
+    }
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include <vector>
+
+// Sealed part of the index: the posting lists of the documents in the slot range
+// [FirstSlot(), EndSlot()). A segment never changes after it is built, so versions
+// of the index share it. Removed documents stay in it until it is merged away.
+class IndexSegment {
+public:
+    // term_ids are sorted, postings[i] belongs to term_ids[i] and is not empty
+    IndexSegment(int first_slot, int end_slot, int document_count,
+                 std::vector<TermId> term_ids, std::vector<PostingList> postings);
+
+    int FirstSlot() const noexcept;
+    int EndSlot() const noexcept;
+    // documents that were alive when the segment was built
+    int DocumentCount() const noexcept;
+
+    const PostingList* FindPostings(TermId term_id) const;
+
+    template <typename Function>
+    void ForEachTerm(Function function) const;
+
+    IndexSegment WithCompression(bool compressed) const;
+
+private:
+    int first_slot_;
+    int end_slot_;
+    int document_count_;
+    std::vector<TermId> term_ids_;
+    std::vector<PostingList> postings_;
+};
+
+template <typename Function>
+void IndexSegment::ForEachTerm(Function function) const {
+    for (size_t i = 0; i < term_ids_.size(); ++i) {
+        function(term_ids_[i], postings_[i]);
+    }
+}
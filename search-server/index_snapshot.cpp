@@ -0,0 +1,238 @@
+#include "index_snapshot.h"
+#include "posting_codec.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0' };
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t payload_size;
+    uint64_t section_count;
+};
+
+}  // namespace
+
+uint64_t ComputeSnapshotChecksum(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void SnapshotWriter::WriteUint32(uint32_t value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    payload_.insert(payload_.end(), bytes, bytes + sizeof(value));
+}
+
+void SnapshotWriter::WriteInt32(int32_t value) {
+    WriteUint32(static_cast<uint32_t>(value));
+}
+
+void SnapshotWriter::WriteString(std::string_view text) {
+    WriteUint32(static_cast<uint32_t>(text.size()));
+    payload_.insert(payload_.end(), text.begin(), text.end());
+}
+
+void SnapshotWriter::WriteBytes(const std::vector<uint8_t>& bytes) {
+    payload_.insert(payload_.end(), bytes.begin(), bytes.end());
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    payload_.insert(payload_.end(), bytes, bytes + size);
+}
+
+void SnapshotWriter::Align(size_t alignment) {
+    // the payload follows the 32-byte header, so its offsets keep the alignment in the file
+    payload_.resize((payload_.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+void SnapshotWriter::BeginSection() {
+    payload_.resize(payload_.size() + sizeof(uint64_t), 0);
+    section_begin_ = payload_.size();
+}
+
+void SnapshotWriter::EndSection() {
+    const uint64_t size = payload_.size() - section_begin_;
+    std::memcpy(payload_.data() + section_begin_ - sizeof(size), &size, sizeof(size));
+    const uint64_t checksum = ComputeSnapshotChecksum(payload_.data() + section_begin_, size);
+    WriteBytes(&checksum, sizeof(checksum));
+    ++section_count_;
+}
+
+void SnapshotWriter::SaveToFile(const std::string& path) const {
+    // encoded postings are decoded straight from the mapping and may be over-read
+    std::vector<uint8_t> payload = payload_;
+    payload.resize(payload.size() + STREAM_VBYTE_PADDING, 0);
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = INDEX_SNAPSHOT_VERSION;
+    header.payload_size = payload.size();
+    header.section_count = section_count_;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    if (!out) {
+        throw std::runtime_error("cannot write index snapshot "s + path);
+    }
+}
+
+#ifndef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open index snapshot "s + path);
+    }
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat index snapshot "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("cannot map index snapshot "s + path);
+        }
+        data_ = static_cast<const uint8_t*>(mapping);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("cannot open index snapshot "s + path);
+    }
+    buffer_.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
+
+const uint8_t* MappedFile::Data() const noexcept {
+    return data_;
+}
+
+size_t MappedFile::Size() const noexcept {
+    return size_;
+}
+
+SnapshotReader::SnapshotReader(const MappedFile& file) {
+    SnapshotHeader header;
+    if (file.Size() < sizeof(header)) {
+        throw std::runtime_error("index snapshot is truncated"s);
+    }
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("file is not an index snapshot"s);
+    }
+    if (header.version != INDEX_SNAPSHOT_VERSION) {
+        throw std::runtime_error("unsupported index snapshot version "s + std::to_string(header.version));
+    }
+    if (header.payload_size != file.Size() - sizeof(header) || header.payload_size < STREAM_VBYTE_PADDING) {
+        throw std::runtime_error("index snapshot is truncated"s);
+    }
+
+    begin_ = file.Data() + sizeof(header);
+    current_ = begin_;
+    end_ = current_ + header.payload_size - STREAM_VBYTE_PADDING;
+    section_end_ = current_;
+    section_count_ = header.section_count;
+}
+
+uint32_t SnapshotReader::ReadUint32() {
+    uint32_t value;
+    std::memcpy(&value, ReadBytes(sizeof(value)), sizeof(value));
+    return value;
+}
+
+int32_t SnapshotReader::ReadInt32() {
+    return static_cast<int32_t>(ReadUint32());
+}
+
+std::string_view SnapshotReader::ReadString() {
+    const uint32_t size = ReadUint32();
+    return { reinterpret_cast<const char*>(ReadBytes(size)), size };
+}
+
+const uint8_t* SnapshotReader::ReadBytes(size_t size) {
+    if (static_cast<size_t>(section_end_ - current_) < size) {
+        throw std::runtime_error("index snapshot is corrupted"s);
+    }
+    const uint8_t* bytes = current_;
+    current_ += size;
+    return bytes;
+}
+
+void SnapshotReader::Align(size_t alignment) {
+    const size_t offset = static_cast<size_t>(current_ - begin_);
+    ReadBytes((alignment - offset % alignment) % alignment);
+}
+
+void SnapshotReader::BeginSection(bool verify) {
+    uint64_t size = 0;
+    uint64_t checksum = 0;
+    if (current_ != section_end_ || section_count_ == 0
+        || static_cast<size_t>(end_ - current_) < sizeof(size) + sizeof(checksum)) {
+        throw std::runtime_error("index snapshot is corrupted"s);
+    }
+    std::memcpy(&size, current_, sizeof(size));
+    current_ += sizeof(size);
+    if (size > static_cast<size_t>(end_ - current_) - sizeof(checksum)) {
+        throw std::runtime_error("index snapshot is corrupted"s);
+    }
+    std::memcpy(&checksum, current_ + size, sizeof(checksum));
+    if (verify && ComputeSnapshotChecksum(current_, static_cast<size_t>(size)) != checksum) {
+        throw std::runtime_error("index snapshot checksum mismatch"s);
+    }
+    section_end_ = current_ + size;
+}
+
+void SnapshotReader::EndSection() {
+    if (current_ != section_end_) {
+        throw std::runtime_error("index snapshot is corrupted"s);
+    }
+    current_ += sizeof(uint64_t);
+    section_end_ = current_;
+    --section_count_;
+}
+
+bool SnapshotReader::AtEnd() const noexcept {
+    return current_ == end_ && section_count_ == 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A snapshot file is a fixed header followed by the payload written through
+// SnapshotWriter. Integers are stored in host byte order, which is little-endian
+// on the supported x86 hosts. The payload is a sequence of sections, each stored as
+// its byte size, its bytes and their FNV-1a checksum, so a reader can check the small
+// tables it parses without touching the pages of the bulk data. Aligned tables of
+// the payload are read in place from the mapped file.
+
+const uint32_t INDEX_SNAPSHOT_VERSION = 3;
+
+// What loading a snapshot checks against the stored checksums. TABLES checks the
+// sections parsed on load and leaves the document texts and the encoded postings
+// unchecked, so their pages are read on first use only; FULL checks every section.
+enum class SnapshotCheck {
+    TABLES,
+    FULL,
+};
+
+uint64_t ComputeSnapshotChecksum(const uint8_t* data, size_t size);
+
+class SnapshotWriter {
+public:
+    void WriteUint32(uint32_t value);
+    void WriteInt32(int32_t value);
+    void WriteString(std::string_view text);
+    void WriteBytes(const std::vector<uint8_t>& bytes);
+    void WriteBytes(const void* data, size_t size);
+    // pads the payload with zero bytes to a multiple of alignment, which is at most 8
+    void Align(size_t alignment);
+    // everything written between the two calls forms one section
+    void BeginSection();
+    void EndSection();
+
+    void SaveToFile(const std::string& path) const;
+
+private:
+    std::vector<uint8_t> payload_;
+    size_t section_begin_ = 0;
+    uint64_t section_count_ = 0;
+};
+
+// Read-only mapping of a whole file, pages are loaded by the OS on first access.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const uint8_t* Data() const noexcept;
+    size_t Size() const noexcept;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> buffer_;
+#endif
+};
+
+// Bounds-checked reader over the payload of a mapped snapshot. The constructor
+// validates the header and the version. Reads are allowed inside a section only.
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const MappedFile& file);
+
+    uint32_t ReadUint32();
+    int32_t ReadInt32();
+    std::string_view ReadString();
+    const uint8_t* ReadBytes(size_t size);
+    // skips the padding of SnapshotWriter::Align
+    void Align(size_t alignment);
+    // with verify set, the checksum of the section is checked before anything is read from it
+    void BeginSection(bool verify);
+    // throws unless the whole section has been read
+    void EndSection();
+
+    // true once the whole payload and all of its sections are read
+    bool AtEnd() const noexcept;
+
+private:
+    const uint8_t* begin_;
+    const uint8_t* current_;
+    const uint8_t* end_;
+    // equal to current_ outside of a section
+    const uint8_t* section_end_;
+    uint64_t section_count_;
+};
@@ -0,0 +1,137 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// the index of the highest set bit of a non-zero value
+int GetTopBit(uint64_t value) noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#elif defined(_MSC_VER)
+    // 32-bit targets scan the halves
+    unsigned long index;
+    if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32))) {
+        return static_cast<int>(index) + 32;
+    }
+    _BitScanReverse(&index, static_cast<unsigned long>(value));
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+}  // namespace
+
+void LatencyHistogram::Record(uint64_t nanoseconds) noexcept {
+    buckets_[GetBucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+    // the extremes change rarely, so they are read before any write
+    uint64_t min = min_.load(std::memory_order_relaxed);
+    while (nanoseconds < min && !min_.compare_exchange_weak(min, nanoseconds, std::memory_order_relaxed)) {
+    }
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::Reset() noexcept {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) noexcept {
+    value = std::min(value, (uint64_t{ 1 } << MAX_VALUE_BITS) - 1);
+    // the first two powers of two have buckets of width one
+    if (value < 2 * SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const int top_bit = GetTopBit(value);
+    const int shift = top_bit - SUB_BUCKET_BITS;
+    return static_cast<size_t>((shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT));
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(size_t index) noexcept {
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int shift = static_cast<int>(index >> SUB_BUCKET_BITS) - 1;
+    return (SUB_BUCKET_COUNT + (index & (SUB_BUCKET_COUNT - 1))) << shift;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) noexcept {
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int shift = static_cast<int>(index >> SUB_BUCKET_BITS) - 1;
+    return GetBucketLowerBound(index) + (uint64_t{ 1 } << shift) - 1;
+}
+
+void HistogramSnapshot::Merge(const LatencyHistogram& histogram) {
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        const uint64_t count = histogram.buckets_[i].load(std::memory_order_relaxed);
+        buckets_[i] += count;
+        // the count is taken from the buckets, so the percentiles agree with it under concurrent records
+        count_ += count;
+    }
+    sum_ += histogram.sum_.load(std::memory_order_relaxed);
+    min_ = std::min(min_, histogram.min_.load(std::memory_order_relaxed));
+    max_ = std::max(max_, histogram.max_.load(std::memory_order_relaxed));
+}
+
+void HistogramSnapshot::Merge(const HistogramSnapshot& other) {
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+uint64_t HistogramSnapshot::GetCount() const noexcept {
+    return count_;
+}
+
+uint64_t HistogramSnapshot::GetSum() const noexcept {
+    return sum_;
+}
+
+uint64_t HistogramSnapshot::GetMin() const noexcept {
+    return count_ == 0 ? 0 : min_;
+}
+
+uint64_t HistogramSnapshot::GetMax() const noexcept {
+    return max_;
+}
+
+double HistogramSnapshot::GetMean() const noexcept {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+uint64_t HistogramSnapshot::GetValueAtPercentile(double percentile) const noexcept {
+    if (count_ == 0) {
+        return 0;
+    }
+    const double clamped = std::clamp(percentile, 0.0, 100.0);
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return std::min(LatencyHistogram::GetBucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
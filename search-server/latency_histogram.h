@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Histogram of durations in nanoseconds with HDR-style buckets: every power of two is split
+// into SUB_BUCKET_COUNT equal buckets, so a recorded value is kept within about 3% at any
+// scale. Recording is a few relaxed atomic adds and may run from any number of threads.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    // larger values, above 18 minutes, are counted in the last bucket
+    static constexpr int MAX_VALUE_BITS = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    void Record(uint64_t nanoseconds) noexcept;
+    // concurrent records may be kept
+    void Reset() noexcept;
+
+    static size_t GetBucketIndex(uint64_t value) noexcept;
+    // the smallest and the largest value counted in the bucket
+    static uint64_t GetBucketLowerBound(size_t index) noexcept;
+    static uint64_t GetBucketUpperBound(size_t index) noexcept;
+
+private:
+    friend class HistogramSnapshot;
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> sum_{ 0 };
+    std::atomic<uint64_t> min_{ UINT64_MAX };
+    std::atomic<uint64_t> max_{ 0 };
+};
+
+// Plain copy of one or several merged histograms, read without synchronization.
+class HistogramSnapshot {
+public:
+    void Merge(const LatencyHistogram& histogram);
+    void Merge(const HistogramSnapshot& other);
+
+    uint64_t GetCount() const noexcept;
+    uint64_t GetSum() const noexcept;
+    uint64_t GetMin() const noexcept;
+    uint64_t GetMax() const noexcept;
+    double GetMean() const noexcept;
+    // the largest value of the bucket holding the percentile, percentile is in [0, 100]
+    uint64_t GetValueAtPercentile(double percentile) const noexcept;
+
+private:
+    std::vector<uint64_t> buckets_ = std::vector<uint64_t>(LatencyHistogram::BUCKET_COUNT, 0);
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
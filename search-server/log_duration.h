@@ -1,7 +1,11 @@
 #pragma once
 
+#include "latency_histogram.h"
+
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
@@ -10,13 +14,21 @@
 
 #define LOG_DURATION_STREAM(x, out) LogDuration UNIQUE_VAR_NAME_PROFILE(x, out)
 
+// records into a LatencyHistogram instead of printing, cheap enough for the hot paths
+#define LOG_DURATION_HISTOGRAM(histogram) LogDuration UNIQUE_VAR_NAME_PROFILE(histogram)
+
 class LogDuration {
 public:
 
     using Clock = std::chrono::steady_clock;
 
     LogDuration(const std::string_view& id, std::ostream& os = std::cerr)
-        : id_(id), os_(os) {
+        : id_(id), os_(&os) {
+
+    }
+
+    explicit LogDuration(LatencyHistogram& histogram)
+        : histogram_(&histogram) {
 
     }
 
@@ -25,14 +37,20 @@ public:
         using namespace std::literals;
 
         const auto end_time = Clock::now();
-        const auto dur = end_time - start_time_;
+        const auto dur = duration_cast<nanoseconds>(end_time - start_time_).count();
 
-        os_ << id_ << ": "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
+        if (histogram_ != nullptr) {
+            histogram_->Record(static_cast<uint64_t>(dur));
+            return;
+        }
+        *os_ << id_ << ": "s << dur << " ns"s << std::endl;
     }
 
 private:
 
     const std::string id_;
-    std::ostream& os_;
+    std::ostream* const os_ = nullptr;
+    LatencyHistogram* const histogram_ = nullptr;
+    // the last member, so the construction of the others is not timed
     const Clock::time_point start_time_ = Clock::now();
 };
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+// Ordered map from non-negative ids to values: a radix trie of 32-way nodes. Copies share
+// the nodes, so a copy costs O(1), and a change copies the path to its leaf if another copy
+// still holds it, O(log n). As with ChunkedVector, reading never changes a node.
+template <typename Value>
+class PersistentIdMap {
+public:
+    class Iterator;
+
+    size_t Size() const noexcept {
+        return size_;
+    }
+
+    // nullptr if the id is absent
+    const Value* Find(int id) const noexcept;
+    // inserts or replaces
+    void Insert(int id, Value value);
+    // returns false if the id is absent
+    bool Erase(int id);
+
+    // the ids in increasing order
+    Iterator begin() const noexcept;
+    Iterator end() const noexcept;
+
+private:
+    static constexpr int NODE_BITS = 5;
+    static constexpr int NODE_SIZE = 1 << NODE_BITS;
+    // enough levels of nodes for any non-negative int
+    static constexpr int MAX_LEVELS = (31 + NODE_BITS - 1) / NODE_BITS;
+
+    struct InnerNode {
+        uint32_t present = 0;
+        // a leaf below level 1, an inner node above
+        std::array<std::shared_ptr<void>, NODE_SIZE> children;
+    };
+
+    struct LeafNode {
+        uint32_t present = 0;
+        std::array<Value, NODE_SIZE> values;
+    };
+
+    std::shared_ptr<void> root_;
+    // levels of inner nodes above the leaves
+    int height_ = 0;
+    size_t size_ = 0;
+
+    static int GetIndex(int id, int level) noexcept {
+        return (id >> (NODE_BITS * level)) & (NODE_SIZE - 1);
+    }
+
+    static uint32_t GetPresent(const void* node, int level) noexcept {
+        return level == 0 ? static_cast<const LeafNode*>(node)->present : static_cast<const InnerNode*>(node)->present;
+    }
+
+    // the first present index from index on, or NODE_SIZE
+    static int FindPresent(uint32_t present, int index) noexcept {
+        while (index < NODE_SIZE && (present >> index & 1) == 0) {
+            ++index;
+        }
+        return index;
+    }
+
+    bool Covers(int id) const noexcept {
+        return (static_cast<uint64_t>(id) >> (NODE_BITS * (height_ + 1))) == 0;
+    }
+
+    template <typename Node>
+    static Node& MutableNode(std::shared_ptr<void>& node);
+};
+
+template <typename Value>
+class PersistentIdMap<Value>::Iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int*;
+    using reference = const int&;
+
+    Iterator() noexcept = default;
+
+    reference operator*() const noexcept {
+        return id_;
+    }
+
+    const Value& GetValue() const noexcept {
+        return static_cast<const LeafNode*>(nodes_[0])->values[indexes_[0]];
+    }
+
+    Iterator& operator++() noexcept;
+
+    Iterator operator++(int) noexcept {
+        Iterator result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const Iterator& other) const noexcept {
+        return nodes_[0] == other.nodes_[0] && indexes_[0] == other.indexes_[0];
+    }
+
+    bool operator!=(const Iterator& other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    friend class PersistentIdMap;
+
+    // the path from the root, nodes_[level] and the index taken in it; no leaf at the end
+    std::array<const void*, MAX_LEVELS> nodes_{};
+    std::array<int, MAX_LEVELS> indexes_{};
+    int height_ = 0;
+    int id_ = 0;
+
+    // from the index taken at level, takes the first present entries below it
+    void Descend(int level) noexcept;
+};
+
+template <typename Value>
+const Value* PersistentIdMap<Value>::Find(int id) const noexcept {
+    if (!root_ || id < 0 || !Covers(id)) {
+        return nullptr;
+    }
+    const void* node = root_.get();
+    for (int level = height_; level > 0; --level) {
+        node = static_cast<const InnerNode*>(node)->children[GetIndex(id, level)].get();
+        if (node == nullptr) {
+            return nullptr;
+        }
+    }
+    const auto* leaf = static_cast<const LeafNode*>(node);
+    const int index = GetIndex(id, 0);
+    return (leaf->present >> index & 1) ? &leaf->values[index] : nullptr;
+}
+
+template <typename Value>
+void PersistentIdMap<Value>::Insert(int id, Value value) {
+    if (!root_) {
+        root_ = std::make_shared<LeafNode>();
+        height_ = 0;
+    }
+    while (!Covers(id)) {
+        auto root = std::make_shared<InnerNode>();
+        root->children[0] = std::move(root_);
+        root->present = 1;
+        root_ = std::move(root);
+        ++height_;
+    }
+    std::shared_ptr<void>* node = &root_;
+    for (int level = height_; level > 0; --level) {
+        InnerNode& inner = MutableNode<InnerNode>(*node);
+        const int index = GetIndex(id, level);
+        node = &inner.children[index];
+        if (!*node) {
+            if (level == 1) {
+                *node = std::make_shared<LeafNode>();
+            } else {
+                *node = std::make_shared<InnerNode>();
+            }
+            inner.present |= uint32_t{ 1 } << index;
+        }
+    }
+    LeafNode& leaf = MutableNode<LeafNode>(*node);
+    const int index = GetIndex(id, 0);
+    if ((leaf.present >> index & 1) == 0) {
+        leaf.present |= uint32_t{ 1 } << index;
+        ++size_;
+    }
+    leaf.values[index] = std::move(value);
+}
+
+template <typename Value>
+bool PersistentIdMap<Value>::Erase(int id) {
+    if (Find(id) == nullptr) {
+        return false;
+    }
+    std::array<std::shared_ptr<void>*, MAX_LEVELS> path;
+    path[height_] = &root_;
+    for (int level = height_; level > 0; --level) {
+        path[level - 1] = &MutableNode<InnerNode>(*path[level]).children[GetIndex(id, level)];
+    }
+    LeafNode& leaf = MutableNode<LeafNode>(*path[0]);
+    const int index = GetIndex(id, 0);
+    leaf.present &= ~(uint32_t{ 1 } << index);
+    leaf.values[index] = Value{};
+    --size_;
+
+    // drops the emptied nodes, the root stays
+    bool is_empty = leaf.present == 0;
+    for (int level = 1; level <= height_ && is_empty; ++level) {
+        auto& inner = *static_cast<InnerNode*>(path[level]->get());
+        const int child_index = GetIndex(id, level);
+        inner.children[child_index].reset();
+        inner.present &= ~(uint32_t{ 1 } << child_index);
+        is_empty = inner.present == 0;
+    }
+    return true;
+}
+
+template <typename Value>
+typename PersistentIdMap<Value>::Iterator PersistentIdMap<Value>::begin() const noexcept {
+    Iterator it;
+    if (size_ == 0) {
+        return it;
+    }
+    it.height_ = height_;
+    it.nodes_[height_] = root_.get();
+    it.indexes_[height_] = FindPresent(GetPresent(root_.get(), height_), 0);
+    it.Descend(height_);
+    return it;
+}
+
+template <typename Value>
+typename PersistentIdMap<Value>::Iterator PersistentIdMap<Value>::end() const noexcept {
+    return {};
+}
+
+template <typename Value>
+template <typename Node>
+Node& PersistentIdMap<Value>::MutableNode(std::shared_ptr<void>& node) {
+    if (node.use_count() != 1) {
+        node = std::make_shared<Node>(*static_cast<const Node*>(node.get()));
+    } else {
+        // the copies that held the node may have just dropped it, their reads come first
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *static_cast<Node*>(node.get());
+}
+
+template <typename Value>
+typename PersistentIdMap<Value>::Iterator& PersistentIdMap<Value>::Iterator::operator++() noexcept {
+    for (int level = 0; level <= height_; ++level) {
+        const int index = FindPresent(GetPresent(nodes_[level], level), indexes_[level] + 1);
+        if (index < NODE_SIZE) {
+            indexes_[level] = index;
+            Descend(level);
+            return *this;
+        }
+    }
+    *this = Iterator{};
+    return *this;
+}
+
+template <typename Value>
+void PersistentIdMap<Value>::Iterator::Descend(int level) noexcept {
+    // the emptied nodes are dropped, so every present child leads to a value
+    for (; level > 0; --level) {
+        nodes_[level - 1] = static_cast<const InnerNode*>(nodes_[level])->children[indexes_[level]].get();
+        indexes_[level - 1] = FindPresent(GetPresent(nodes_[level - 1], level - 1), 0);
+    }
+    id_ = 0;
+    for (int i = height_; i >= 0; --i) {
+        id_ = (id_ << NODE_BITS) | indexes_[i];
+    }
+}
@@ -0,0 +1,154 @@
+#include "posting_codec.h"
+
+#include <array>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define POSTING_CODEC_SSSE3 __attribute__((target("ssse3")))
+#define POSTING_CODEC_HAS_SIMD
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define POSTING_CODEC_SSSE3
+#define POSTING_CODEC_HAS_SIMD
+#endif
+
+namespace {
+
+int ByteLengthCode(uint32_t value) {
+    if (value < (1u << 8)) {
+        return 0;
+    }
+    if (value < (1u << 16)) {
+        return 1;
+    }
+    if (value < (1u << 24)) {
+        return 2;
+    }
+    return 3;
+}
+
+struct DecodeTables {
+    std::array<std::array<uint8_t, 16>, 256> shuffles;
+    std::array<uint8_t, 256> lengths;
+
+    DecodeTables() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t source = 0;
+            for (int value = 0; value < 4; ++value) {
+                const int length = ((control >> (2 * value)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    shuffles[control][value * 4 + byte] = byte < length ? source++ : 0x80;
+                }
+            }
+            lengths[control] = source;
+        }
+    }
+};
+
+const DecodeTables& GetDecodeTables() {
+    static const DecodeTables tables;
+    return tables;
+}
+
+const uint8_t* DecodeScalar(const uint8_t* control, const uint8_t* data, size_t count, uint32_t* values) {
+    for (size_t i = 0; i < count; ++i) {
+        const int length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (int byte = 0; byte < length; ++byte) {
+            value |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        data += length;
+        values[i] = value;
+    }
+    return data;
+}
+
+#ifdef POSTING_CODEC_HAS_SIMD
+
+bool HasSsse3() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    static const bool has_ssse3 = (info[2] & (1 << 9)) != 0;
+#else
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+    return has_ssse3;
+}
+
+POSTING_CODEC_SSSE3
+const uint8_t* DecodeSsse3(const uint8_t* control, const uint8_t* data, size_t count, uint32_t* values) {
+    const DecodeTables& tables = GetDecodeTables();
+    const size_t group_count = count / 4;
+    for (size_t group = 0; group < group_count; ++group) {
+        const uint8_t code = control[group];
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffles[code].data()));
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + group * 4), _mm_shuffle_epi8(bytes, shuffle));
+        data += tables.lengths[code];
+    }
+    const size_t decoded = group_count * 4;
+    return DecodeScalar(control + group_count, data, count - decoded, values + decoded);
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define POSTING_CODEC_HAS_SSE2
+
+void DecodeDeltasSse2(uint32_t* values, size_t count, uint32_t base) {
+    __m128i running = _mm_set1_epi32(static_cast<int>(base));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i gaps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        gaps = _mm_add_epi32(gaps, _mm_slli_si128(gaps, 4));
+        gaps = _mm_add_epi32(gaps, _mm_slli_si128(gaps, 8));
+        running = _mm_add_epi32(gaps, running);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), running);
+        running = _mm_shuffle_epi32(running, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(running));
+    for (; i < count; ++i) {
+        last += values[i];
+        values[i] = last;
+    }
+}
+
+#endif
+
+#endif
+
+}  // namespace
+
+void EncodeStreamVByte(const uint32_t* values, size_t count, std::vector<uint8_t>& out) {
+    const size_t control_start = out.size();
+    out.resize(control_start + (count + 3) / 4, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const int code = ByteLengthCode(values[i]);
+        out[control_start + i / 4] |= static_cast<uint8_t>(code << (2 * (i % 4)));
+        for (int byte = 0; byte <= code; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* values) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+#ifdef POSTING_CODEC_HAS_SIMD
+    if (HasSsse3()) {
+        return DecodeSsse3(control, data, count, values);
+    }
+#endif
+    return DecodeScalar(control, data, count, values);
+}
+
+void DecodeDeltas(uint32_t* values, size_t count, uint32_t base) {
+#ifdef POSTING_CODEC_HAS_SSE2
+    DecodeDeltasSse2(values, count, base);
+#else
+    for (size_t i = 0; i < count; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+#endif
+}
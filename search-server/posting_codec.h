@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// StreamVByte coding of 32-bit integers: a control stream with a 2-bit byte
+// length per value followed by the data stream with the significant bytes.
+// The decoder may read up to STREAM_VBYTE_PADDING bytes past the encoded data.
+
+const size_t STREAM_VBYTE_PADDING = 16;
+
+void EncodeStreamVByte(const uint32_t* values, size_t count, std::vector<uint8_t>& out);
+
+// returns the position right after the decoded sequence
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* values);
+
+// turns slot gaps into slots in place
+void DecodeDeltas(uint32_t* values, size_t count, uint32_t base);
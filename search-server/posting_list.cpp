@@ -0,0 +1,395 @@
+#include "posting_list.h"
+#include "posting_codec.h"
+
+#include <algorithm>
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+    : postings_(&postings)
+{
+    LoadSegment(0);
+}
+
+void PostingList::Cursor::Reset(const PostingList& postings) {
+    postings_ = &postings;
+    LoadSegment(0);
+}
+
+int PostingList::Cursor::Slot() const noexcept {
+    return position_ == SegmentSize() ? END_SLOT : SegmentData()[position_].slot;
+}
+
+double PostingList::Cursor::TermFreq() const noexcept {
+    return SegmentData()[position_].term_freq;
+}
+
+void PostingList::Cursor::Next() {
+    ++position_;
+    if (position_ == SegmentSize() && block_index_ < postings_->block_count_) {
+        LoadSegment(block_index_ + 1);
+    }
+}
+
+void PostingList::Cursor::SkipTo(int slot) {
+    if (Slot() >= slot) {
+        return;
+    }
+
+    // whole blocks are skipped by their last slot without being decoded
+    const Block* blocks = postings_->blocks_;
+    const size_t block_count = postings_->block_count_;
+    if (block_index_ < block_count && blocks[block_index_].last_slot < slot) {
+        const Block* block = std::partition_point(blocks + block_index_ + 1, blocks + block_count,
+            [slot](const Block& candidate) {
+                return candidate.last_slot < slot;
+            });
+        LoadSegment(static_cast<size_t>(block - blocks));
+    }
+
+    // gallop first, the target is usually close to the current position
+    const Posting* data = SegmentData();
+    const size_t size = SegmentSize();
+    size_t step = 1;
+    while (position_ < size && data[position_].slot < slot) {
+        const size_t probe = std::min(position_ + step, size - 1);
+        if (data[probe].slot >= slot) {
+            position_ = static_cast<size_t>(std::lower_bound(data + position_, data + probe + 1, slot,
+                [](const Posting& posting, int value) {
+                    return posting.slot < value;
+                }) - data);
+            return;
+        }
+        position_ = probe + 1;
+        step *= 2;
+    }
+}
+
+const Posting* PostingList::Cursor::SegmentData() const noexcept {
+    return block_index_ < postings_->block_count_ ? decoded_.data() : postings_->postings_.data();
+}
+
+size_t PostingList::Cursor::SegmentSize() const noexcept {
+    return block_index_ < postings_->block_count_ ? decoded_.size() : postings_->postings_.size();
+}
+
+void PostingList::Cursor::LoadSegment(size_t block_index) {
+    block_index_ = block_index;
+    position_ = 0;
+    if (block_index_ < postings_->block_count_) {
+        postings_->DecodeBlock(block_index_, decoded_);
+    }
+}
+
+PostingList::PostingList(const PostingList& other)
+    : is_compressed_(other.is_compressed_)
+    , blocks_(other.blocks_)
+    , block_count_(other.block_count_)
+    , block_data_(other.block_data_)
+    , owned_blocks_(other.owned_blocks_)
+    , owned_block_data_(other.owned_block_data_)
+    , block_owner_(other.block_owner_)
+    , postings_(other.postings_)
+    , size_(other.size_)
+    , max_term_freq_(other.max_term_freq_)
+{
+    UpdateBlockPointers();
+}
+
+PostingList::PostingList(PostingList&& other) noexcept {
+    *this = std::move(other);
+}
+
+PostingList& PostingList::operator=(const PostingList& other) {
+    if (this != &other) {
+        *this = PostingList(other);
+    }
+    return *this;
+}
+
+PostingList& PostingList::operator=(PostingList&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    is_compressed_ = other.is_compressed_;
+    blocks_ = other.blocks_;
+    block_count_ = other.block_count_;
+    block_data_ = other.block_data_;
+    owned_blocks_ = std::move(other.owned_blocks_);
+    owned_block_data_ = std::move(other.owned_block_data_);
+    block_owner_ = std::move(other.block_owner_);
+    postings_ = std::move(other.postings_);
+    size_ = other.size_;
+    max_term_freq_ = other.max_term_freq_;
+    UpdateBlockPointers();
+
+    // the moved-from list is left empty
+    other.owned_blocks_.clear();
+    other.owned_block_data_.clear();
+    other.block_owner_.reset();
+    other.postings_.clear();
+    other.size_ = 0;
+    other.max_term_freq_ = 0.0;
+    other.UpdateBlockPointers();
+    return *this;
+}
+
+PostingList PostingList::FromEncodedBlocks(const Block* blocks, size_t block_count, const uint8_t* block_data,
+                                           size_t size, double max_term_freq, std::shared_ptr<const void> owner) {
+    PostingList result;
+    result.is_compressed_ = true;
+    result.blocks_ = blocks;
+    result.block_count_ = block_count;
+    result.block_data_ = block_data;
+    result.block_owner_ = std::move(owner);
+    result.size_ = size;
+    result.max_term_freq_ = max_term_freq;
+    return result;
+}
+
+void PostingList::Add(int slot, int term_count, int document_length) {
+    const double term_freq = static_cast<double>(term_count) / document_length;
+    const Posting posting{ slot, document_length, term_freq };
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+
+    const bool after_blocks = block_count_ == 0 || blocks_[block_count_ - 1].last_slot < slot;
+    if (after_blocks && (postings_.empty() || postings_.back().slot < slot)) {
+        // slots are handed out in increasing order, so this is normally an append
+        postings_.push_back(posting);
+        ++size_;
+        if (is_compressed_ && postings_.size() == BLOCK_SIZE) {
+            SealTail();
+        }
+        return;
+    }
+
+    if (!after_blocks) {
+        // out of order insert into the encoded part, fall back to the plain layout for it
+        Unpack();
+    }
+    const auto it = LowerBound(postings_, slot);
+    if (it != postings_.end() && it->slot == slot) {
+        postings_[it - postings_.begin()] = posting;
+        UpdateMaxTermFreq();
+    } else {
+        postings_.insert(it, posting);
+        ++size_;
+    }
+    if (is_compressed_) {
+        SealTail();
+    }
+}
+
+size_t PostingList::Remove(const int* first, const int* last) {
+    if (first == last) {
+        return 0;
+    }
+    // the encoded part is rebuilt once for the whole batch
+    Unpack();
+    size_t kept_count = 0;
+    for (size_t i = 0; i < postings_.size(); ++i) {
+        first = std::lower_bound(first, last, postings_[i].slot);
+        if (first == last || *first != postings_[i].slot) {
+            postings_[kept_count++] = postings_[i];
+        }
+    }
+    const size_t removed_count = postings_.size() - kept_count;
+    postings_.resize(kept_count);
+    size_ -= removed_count;
+    if (removed_count > 0) {
+        UpdateMaxTermFreq();
+    }
+    if (is_compressed_) {
+        SealTail();
+    }
+    return removed_count;
+}
+
+bool PostingList::Contains(int slot) const {
+    const Block* block = std::partition_point(blocks_, blocks_ + block_count_,
+        [slot](const Block& candidate) {
+            return candidate.last_slot < slot;
+        });
+    if (block == blocks_ + block_count_) {
+        const auto it = LowerBound(postings_, slot);
+        return it != postings_.end() && it->slot == slot;
+    }
+    if (block->first_slot > slot) {
+        return false;
+    }
+    // only the slots are needed, they are decoded on the stack
+    uint32_t slots[BLOCK_SIZE];
+    DecodeStreamVByte(block_data_ + block->offset, block->size, slots);
+    DecodeDeltas(slots, block->size, static_cast<uint32_t>(block->first_slot));
+    return std::binary_search(slots, slots + block->size, static_cast<uint32_t>(slot));
+}
+
+size_t PostingList::Size() const noexcept {
+    return size_;
+}
+
+bool PostingList::Empty() const noexcept {
+    return size_ == 0;
+}
+
+double PostingList::MaxTermFreq() const noexcept {
+    return max_term_freq_;
+}
+
+void PostingList::SetCompressed(bool compressed) {
+    if (compressed == is_compressed_) {
+        return;
+    }
+    is_compressed_ = compressed;
+    if (is_compressed_) {
+        SealTail();
+    } else {
+        Unpack();
+    }
+}
+
+bool PostingList::IsCompressed() const noexcept {
+    return is_compressed_;
+}
+
+void PostingList::EncodeTail() {
+    SealTail();
+    if (postings_.empty()) {
+        return;
+    }
+    OwnBlocks();
+    if (!owned_block_data_.empty()) {
+        owned_block_data_.resize(owned_block_data_.size() - STREAM_VBYTE_PADDING);
+    }
+    owned_blocks_.emplace_back();
+    EncodeBlock(postings_.data(), postings_.size(), owned_block_data_, owned_blocks_.back());
+    owned_block_data_.resize(owned_block_data_.size() + STREAM_VBYTE_PADDING, 0);
+    postings_.clear();
+    UpdateBlockPointers();
+}
+
+const PostingList::Block* PostingList::GetBlocks() const noexcept {
+    return blocks_;
+}
+
+size_t PostingList::GetBlockCount() const noexcept {
+    return block_count_;
+}
+
+const uint8_t* PostingList::GetBlockData() const noexcept {
+    return block_data_;
+}
+
+size_t PostingList::GetBlockDataSize() const noexcept {
+    // the blocks lie one after another
+    return block_count_ == 0 ? 0 : blocks_[block_count_ - 1].offset + blocks_[block_count_ - 1].byte_size;
+}
+
+std::vector<Posting>::const_iterator PostingList::LowerBound(const std::vector<Posting>& postings, int slot) {
+    return std::lower_bound(postings.begin(), postings.end(), slot,
+        [](const Posting& posting, int value) {
+            return posting.slot < value;
+        });
+}
+
+void PostingList::DecodeBlock(size_t block_index, std::vector<Posting>& out) const {
+    const Block& block = blocks_[block_index];
+    uint32_t slots[BLOCK_SIZE];
+    uint32_t term_counts[BLOCK_SIZE];
+    uint32_t document_lengths[BLOCK_SIZE];
+
+    const uint8_t* in = block_data_ + block.offset;
+    in = DecodeStreamVByte(in, block.size, slots);
+    in = DecodeStreamVByte(in, block.size, term_counts);
+    DecodeStreamVByte(in, block.size, document_lengths);
+    DecodeDeltas(slots, block.size, static_cast<uint32_t>(block.first_slot));
+
+    out.resize(block.size);
+    for (size_t i = 0; i < block.size; ++i) {
+        const int document_length = static_cast<int>(document_lengths[i]);
+        out[i] = { static_cast<int>(slots[i]), document_length, static_cast<double>(term_counts[i]) / document_length };
+    }
+}
+
+void PostingList::EncodeBlock(const Posting* postings, size_t count, std::vector<uint8_t>& out, Block& block) const {
+    uint32_t slot_gaps[BLOCK_SIZE];
+    uint32_t term_counts[BLOCK_SIZE];
+    uint32_t document_lengths[BLOCK_SIZE];
+
+    int previous_slot = postings[0].slot;
+    for (size_t i = 0; i < count; ++i) {
+        slot_gaps[i] = static_cast<uint32_t>(postings[i].slot - previous_slot);
+        previous_slot = postings[i].slot;
+        // term_freq was computed as term_count / document_length, so the product rounds back exactly
+        term_counts[i] = static_cast<uint32_t>(postings[i].term_freq * postings[i].document_length + 0.5);
+        document_lengths[i] = static_cast<uint32_t>(postings[i].document_length);
+    }
+
+    block.first_slot = postings[0].slot;
+    block.last_slot = postings[count - 1].slot;
+    block.offset = static_cast<uint32_t>(out.size());
+    block.size = static_cast<uint32_t>(count);
+    EncodeStreamVByte(slot_gaps, count, out);
+    EncodeStreamVByte(term_counts, count, out);
+    EncodeStreamVByte(document_lengths, count, out);
+    block.byte_size = static_cast<uint32_t>(out.size()) - block.offset;
+}
+
+void PostingList::SealTail() {
+    if (postings_.size() < BLOCK_SIZE) {
+        return;
+    }
+    OwnBlocks();
+    if (!owned_block_data_.empty()) {
+        owned_block_data_.resize(owned_block_data_.size() - STREAM_VBYTE_PADDING);
+    }
+    size_t sealed = 0;
+    for (; sealed + BLOCK_SIZE <= postings_.size(); sealed += BLOCK_SIZE) {
+        owned_blocks_.emplace_back();
+        EncodeBlock(postings_.data() + sealed, BLOCK_SIZE, owned_block_data_, owned_blocks_.back());
+    }
+    owned_block_data_.resize(owned_block_data_.size() + STREAM_VBYTE_PADDING, 0);
+    postings_.erase(postings_.begin(), postings_.begin() + sealed);
+    UpdateBlockPointers();
+}
+
+void PostingList::Unpack() {
+    if (block_count_ == 0) {
+        return;
+    }
+    std::vector<Posting> postings;
+    postings.reserve(size_);
+    ForEach([&postings](const Posting& posting) {
+        postings.push_back(posting);
+    });
+    postings_ = std::move(postings);
+    owned_blocks_.clear();
+    owned_block_data_.clear();
+    block_owner_.reset();
+    UpdateBlockPointers();
+}
+
+void PostingList::OwnBlocks() {
+    if (!block_owner_) {
+        return;
+    }
+    owned_blocks_.assign(blocks_, blocks_ + block_count_);
+    owned_block_data_.assign(block_data_, block_data_ + GetBlockDataSize());
+    owned_block_data_.resize(owned_block_data_.size() + STREAM_VBYTE_PADDING, 0);
+    block_owner_.reset();
+    UpdateBlockPointers();
+}
+
+void PostingList::UpdateBlockPointers() noexcept {
+    if (block_owner_) {
+        return;
+    }
+    blocks_ = owned_blocks_.data();
+    block_count_ = owned_blocks_.size();
+    block_data_ = owned_block_data_.data();
+}
+
+void PostingList::UpdateMaxTermFreq() {
+    max_term_freq_ = 0.0;
+    ForEach([this](const Posting& posting) {
+        max_term_freq_ = std::max(max_term_freq_, posting.term_freq);
+    });
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+struct Posting {
+    int slot;
+    // kept to rebuild the exact term frequency from the compressed term count, fits into padding
+    int document_length;
+    double term_freq;
+};
+
+// Postings of a single term sorted by document slot. The list is either a plain
+// vector or, when compressed, a sequence of encoded blocks of BLOCK_SIZE postings
+// followed by a short plain tail that collects new postings until it fills a block.
+// The encoded blocks are owned by the list or borrowed from a mapped snapshot.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+    static constexpr int END_SLOT = std::numeric_limits<int>::max();
+
+    // postings [offset, offset + byte_size) of the block data, up to BLOCK_SIZE of them
+    struct Block {
+        int first_slot;
+        int last_slot;
+        uint32_t offset;
+        uint32_t byte_size;
+        uint32_t size;
+    };
+
+    // Forward-only position in the list for document-at-a-time evaluation.
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings);
+
+        // moves to the start of another list and keeps the decoding buffer
+        void Reset(const PostingList& postings);
+
+        int Slot() const noexcept;
+        double TermFreq() const noexcept;
+
+        void Next();
+        void SkipTo(int slot);
+
+    private:
+        const PostingList* postings_;
+        size_t block_index_ = 0;
+        size_t position_ = 0;
+        std::vector<Posting> decoded_;
+
+        const Posting* SegmentData() const noexcept;
+        size_t SegmentSize() const noexcept;
+        void LoadSegment(size_t block_index);
+    };
+
+    PostingList() = default;
+    PostingList(const PostingList& other);
+    PostingList(PostingList&& other) noexcept;
+    PostingList& operator=(const PostingList& other);
+    PostingList& operator=(PostingList&& other) noexcept;
+
+    // A compressed list over blocks kept outside of it, e.g. in a mapped snapshot, that
+    // owner keeps alive. The block data must be followed by STREAM_VBYTE_PADDING readable
+    // bytes. The blocks are copied only if the list is changed.
+    static PostingList FromEncodedBlocks(const Block* blocks, size_t block_count, const uint8_t* block_data,
+                                         size_t size, double max_term_freq, std::shared_ptr<const void> owner);
+
+    void Add(int slot, int term_count, int document_length);
+    // removes the sorted slots [first, last) in one pass, returns how many were found
+    size_t Remove(const int* first, const int* last);
+
+    bool Contains(int slot) const;
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    size_t Size() const noexcept;
+    bool Empty() const noexcept;
+    double MaxTermFreq() const noexcept;
+
+    void SetCompressed(bool compressed);
+    bool IsCompressed() const noexcept;
+
+    // Encodes the plain tail too, into a last short block, so that the blocks hold the
+    // whole list, e.g. to write it out. The list must be compressed.
+    void EncodeTail();
+    const Block* GetBlocks() const noexcept;
+    size_t GetBlockCount() const noexcept;
+    const uint8_t* GetBlockData() const noexcept;
+    // without the padding
+    size_t GetBlockDataSize() const noexcept;
+
+private:
+    bool is_compressed_ = false;
+    // the encoded blocks, in owned_blocks_ and owned_block_data_ unless borrowed
+    const Block* blocks_ = nullptr;
+    size_t block_count_ = 0;
+    const uint8_t* block_data_ = nullptr;
+    std::vector<Block> owned_blocks_;
+    // encoded blocks followed by STREAM_VBYTE_PADDING zero bytes
+    std::vector<uint8_t> owned_block_data_;
+    // keeps borrowed blocks alive, null while the blocks are owned
+    std::shared_ptr<const void> block_owner_;
+    std::vector<Posting> postings_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    static std::vector<Posting>::const_iterator LowerBound(const std::vector<Posting>& postings, int slot);
+
+    void DecodeBlock(size_t block_index, std::vector<Posting>& out) const;
+    void EncodeBlock(const Posting* postings, size_t count, std::vector<uint8_t>& out, Block& block) const;
+    void SealTail();
+    void Unpack();
+    // copies borrowed blocks into the owned storage before they are changed
+    void OwnBlocks();
+    void UpdateBlockPointers() noexcept;
+    void UpdateMaxTermFreq();
+};
+
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    if (block_count_ > 0) {
+        std::vector<Posting> decoded;
+        decoded.reserve(BLOCK_SIZE);
+        for (size_t block_index = 0; block_index < block_count_; ++block_index) {
+            DecodeBlock(block_index, decoded);
+            for (const Posting& posting : decoded) {
+                function(posting);
+            }
+        }
+    }
+    for (const Posting& posting : postings_) {
+        function(posting);
+    }
+}
@@ -1,25 +1,142 @@
 #include "process_queries.h"
-#include <execution>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    QueryExecutor& GetDefaultQueryExecutor()
+    {
+        static QueryExecutor executor;
+        return executor;
+    }
+}
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries)
+{
+    return ProcessQueries(GetDefaultQueryExecutor(), search_server, queries);
+}
+
+std::vector<std::vector<Document>> ProcessQueries(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries)
 {
     std::vector<std::vector<Document>> to_return(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), to_return.begin(), [&search_server](std::string raw)
+    executor.Run(queries.size(), [&](size_t i)
         {
-            return search_server.FindTopDocuments(raw);
+            to_return[i] = search_server.FindTopDocuments(queries[i]);
         });
     return to_return;
 }
 
-std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries)
+std::vector<std::vector<Document>> ProcessQueries(const VersionedSearchServer& search_server, const std::vector<std::string>& queries)
 {
-    std::list<Document> documents;
-    for (auto& same_query_docs : ProcessQueries(search_server, queries))
+    const auto snapshot = search_server.GetSnapshot();
+    return ProcessQueries(*snapshot, queries);
+}
+
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries)
+{
+    std::vector<Document> documents;
+    ProcessQueriesJoined(search_server, queries, [&documents](const Document& document)
+        {
+            documents.push_back(document);
+        });
+    return documents;
+}
+
+void ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries,
+                          const std::function<void(const Document&)>& sink)
+{
+    QueryExecutor& executor = GetDefaultQueryExecutor();
+    // The queries are claimed in order, so only those finished ahead of a slower earlier
+    // one wait in the buffer. A query is claimed only within window of the next one to
+    // output, so the buffer holds fewer than window results whatever the delay.
+    const size_t window = 2 * (executor.GetWorkerCount() + 1);
+    std::mutex output_mutex;
+    std::condition_variable output_advanced;
+    size_t next_query = 0;
+    size_t next_output = 0;
+    std::map<size_t, std::vector<Document>> finished;
+    // the first failure of a query or of sink, the workers stop claiming queries once it is set
+    std::exception_ptr error;
+
+    const auto output = [&sink, &next_output](const std::vector<Document>& documents)
+    {
+        for (const Document& document : documents)
+        {
+            sink(document);
+        }
+        ++next_output;
+    };
+
+    // under output_mutex; next_output will not advance any more, so the waiting workers are woken to leave
+    const auto fail = [&error, &output_advanced](std::exception_ptr query_error)
     {
-        for (auto& doc : same_query_docs)
+        if (!error)
         {
-            documents.push_back(doc);
+            error = query_error;
         }
+        output_advanced.notify_all();
+    };
+
+    executor.Run(executor.GetWorkerCount() + 1, [&](size_t)
+        {
+            while (true)
+            {
+                size_t query = 0;
+                {
+                    // the query next_output is already claimed and running, so the wait ends
+                    std::unique_lock lock(output_mutex);
+                    output_advanced.wait(lock, [&]()
+                        {
+                            return error || next_query == queries.size() || next_query < next_output + window;
+                        });
+                    if (error || next_query == queries.size())
+                    {
+                        return;
+                    }
+                    query = next_query++;
+                }
+
+                std::vector<Document> documents;
+                try
+                {
+                    documents = search_server.FindTopDocuments(queries[query]);
+                }
+                catch (...)
+                {
+                    std::lock_guard guard(output_mutex);
+                    fail(std::current_exception());
+                    return;
+                }
+                std::lock_guard guard(output_mutex);
+                if (error)
+                {
+                    return;
+                }
+                if (query != next_output)
+                {
+                    finished.emplace(query, std::move(documents));
+                    continue;
+                }
+                try
+                {
+                    output(documents);
+                    for (auto it = finished.begin(); it != finished.end() && it->first == next_output; it = finished.erase(it))
+                    {
+                        output(it->second);
+                    }
+                }
+                catch (...)
+                {
+                    fail(std::current_exception());
+                    return;
+                }
+                output_advanced.notify_all();
+            }
+        });
+    if (error)
+    {
+        std::rethrow_exception(error);
     }
-    return documents;
-}
\ No newline at end of file
+}
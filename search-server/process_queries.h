@@ -1,11 +1,36 @@
 #pragma once
 #include "search_server.h"
-#include <list>
+#include "versioned_search_server.h"
+#include "query_executor.h"
+#include <functional>
 
+// Runs the queries on a shared pool of workers, see QueryExecutor
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// All queries see the same version of the index, even if it is updated meanwhile
+std::vector<std::vector<Document>> ProcessQueries(
+    const VersionedSearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Results of all the queries one after another, in query order
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Streams the joined results: the documents of a query are passed to sink as soon as
+// it and all the queries before it are done, while the later ones are still running.
+// The calls to sink are serialized and may come from any worker. The workers stay within
+// twice their number of queries past the last query output, so a slow query or sink
+// holds back a bounded number of results. If a query or sink throws, the remaining
+// queries are dropped and the first exception is rethrown once the workers are done.
+void ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries,
+    const std::function<void(const Document&)>& sink);
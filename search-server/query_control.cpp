@@ -0,0 +1,40 @@
+#include "query_control.h"
+
+QueryControl::QueryControl()
+    : QueryControl(Clock::time_point::max())
+{
+}
+
+QueryControl::QueryControl(Clock::time_point deadline)
+    : state_(std::make_shared<State>())
+{
+    state_->deadline = deadline;
+}
+
+QueryControl::QueryControl(Clock::duration timeout)
+    : QueryControl(Clock::now() + timeout)
+{
+}
+
+void QueryControl::Cancel() {
+    state_->is_cancelled.store(true, std::memory_order_relaxed);
+}
+
+bool QueryControl::IsCancelled() const {
+    return state_->is_cancelled.load(std::memory_order_relaxed);
+}
+
+bool QueryControl::IsStopped() const {
+    return state_->is_stopped.load(std::memory_order_relaxed);
+}
+
+bool QueryControl::ShouldStop() const {
+    if (state_->is_stopped.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if (IsCancelled() || (state_->deadline != Clock::time_point::max() && Clock::now() >= state_->deadline)) {
+        state_->is_stopped.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Deadline and cancellation of a query. Copies share one state, so a query can be
+// cancelled through any copy from any thread. The search checks it between posting
+// blocks and, once it fires, returns the best documents among those scored so far.
+class QueryControl {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // neither a deadline nor a cancellation yet
+    QueryControl();
+    explicit QueryControl(Clock::time_point deadline);
+    explicit QueryControl(Clock::duration timeout);
+
+    void Cancel();
+    bool IsCancelled() const;
+
+    // whether a query run with this control was cut short, its result is then partial
+    bool IsStopped() const;
+
+    // called by the search, marks the control as stopped once the query has to end
+    bool ShouldStop() const;
+
+private:
+    struct State {
+        Clock::time_point deadline;
+        std::atomic<bool> is_cancelled{ false };
+        std::atomic<bool> is_stopped{ false };
+    };
+
+    std::shared_ptr<State> state_;
+};
@@ -0,0 +1,163 @@
+#include "query_executor.h"
+
+#include <algorithm>
+
+namespace {
+
+// the executor whose task runs on this thread
+thread_local const QueryExecutor* current_executor = nullptr;
+
+}  // namespace
+
+QueryExecutor::QueryExecutor(size_t worker_count)
+    // the last queue belongs to the calling thread
+    : queues_(worker_count + 1)
+{
+    workers_.reserve(worker_count);
+    for (size_t worker_index = 0; worker_index < worker_count; ++worker_index) {
+        workers_.emplace_back([this, worker_index]() {
+            RunWorker(worker_index);
+        });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard guard(state_mutex_);
+        is_stopping_ = true;
+    }
+    batch_started_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void QueryExecutor::Run(size_t task_count, const std::function<void(size_t)>& task) {
+    if (task_count == 0) {
+        return;
+    }
+    if (current_executor == this) {
+        // waiting for run_mutex_ here would wait for the batch this task belongs to
+        RunInline(task_count, task);
+        return;
+    }
+    std::lock_guard run_guard(run_mutex_);
+
+    // several chunks per queue leave something to steal when the tasks are uneven
+    const size_t chunk_count = std::min(task_count, queues_.size() * 8);
+    {
+        std::lock_guard guard(state_mutex_);
+        task_ = &task;
+        remaining_count_ = task_count;
+        error_ = nullptr;
+    }
+    for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+        // contiguous chunks go to the same queue, so a worker sees neighbouring tasks
+        WorkerQueue& queue = queues_[chunk_index * queues_.size() / chunk_count];
+        std::lock_guard guard(queue.mutex);
+        queue.chunks.push_back({ task_count * chunk_index / chunk_count, task_count * (chunk_index + 1) / chunk_count });
+    }
+    {
+        std::lock_guard guard(state_mutex_);
+        ++batch_number_;
+    }
+    batch_started_.notify_all();
+
+    RunChunks(queues_.size() - 1);
+
+    std::unique_lock lock(state_mutex_);
+    batch_finished_.wait(lock, [this]() { return remaining_count_ == 0; });
+    task_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+size_t QueryExecutor::GetWorkerCount() const noexcept {
+    return workers_.size();
+}
+
+void QueryExecutor::RunWorker(size_t worker_index) {
+    size_t seen_batch_number = 0;
+    while (true) {
+        {
+            std::unique_lock lock(state_mutex_);
+            batch_started_.wait(lock, [this, seen_batch_number]() {
+                return is_stopping_ || batch_number_ != seen_batch_number;
+            });
+            if (is_stopping_) {
+                return;
+            }
+            seen_batch_number = batch_number_;
+        }
+        RunChunks(worker_index);
+    }
+}
+
+bool QueryExecutor::TakeChunk(size_t queue_index, Chunk& chunk) {
+    {
+        WorkerQueue& own = queues_[queue_index];
+        std::lock_guard guard(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        WorkerQueue& victim = queues_[(queue_index + offset) % queues_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void QueryExecutor::RunChunks(size_t queue_index) {
+    // the calling thread may be running a task of another executor
+    const QueryExecutor* const outer_executor = std::exchange(current_executor, this);
+    Chunk chunk;
+    while (TakeChunk(queue_index, chunk)) {
+        // the chunk was queued after task_ was set, its queue mutex orders the two
+        const std::function<void(size_t)>& task = *task_;
+        std::exception_ptr error;
+        for (size_t index = chunk.first; index < chunk.last; ++index) {
+            try {
+                task(index);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        std::lock_guard guard(state_mutex_);
+        if (error && !error_) {
+            error_ = error;
+        }
+        remaining_count_ -= chunk.last - chunk.first;
+        if (remaining_count_ == 0) {
+            batch_finished_.notify_all();
+        }
+    }
+    current_executor = outer_executor;
+}
+
+void QueryExecutor::RunInline(size_t task_count, const std::function<void(size_t)>& task) {
+    std::exception_ptr error;
+    for (size_t index = 0; index < task_count; ++index) {
+        try {
+            task(index);
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
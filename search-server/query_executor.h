@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed pool of workers for batches of independent tasks. A batch is cut into
+// chunks spread over the workers' deques; a worker takes chunks from the back of
+// its own deque and, once it runs dry, steals from the front of the others. The
+// calling thread helps as well, so a batch runs even on a pool without workers.
+class QueryExecutor {
+public:
+    explicit QueryExecutor(size_t worker_count = std::thread::hardware_concurrency());
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    // Calls task(i) for every i in [0, task_count) and waits for all of them. Neighbouring
+    // indexes go to the same chunk. The first exception thrown by a task is rethrown here.
+    // Called from a task of this executor, it runs the tasks on the calling thread instead,
+    // the batch being run holds the pool.
+    void Run(size_t task_count, const std::function<void(size_t)>& task);
+
+    size_t GetWorkerCount() const noexcept;
+
+private:
+    struct Chunk {
+        size_t first;
+        size_t last;
+    };
+
+    // queues are padded to separate cache lines, so workers do not invalidate each other's caches
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct alignas(CACHE_LINE_SIZE) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<WorkerQueue> queues_;
+    std::vector<std::thread> workers_;
+
+    // one batch at a time
+    std::mutex run_mutex_;
+
+    std::mutex state_mutex_;
+    std::condition_variable batch_started_;
+    std::condition_variable batch_finished_;
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t batch_number_ = 0;
+    size_t remaining_count_ = 0;
+    std::exception_ptr error_;
+    bool is_stopping_ = false;
+
+    void RunWorker(size_t worker_index);
+    bool TakeChunk(size_t queue_index, Chunk& chunk);
+    void RunChunks(size_t queue_index);
+    void RunInline(size_t task_count, const std::function<void(size_t)>& task);
+};
@@ -0,0 +1,29 @@
+#include "query_explanation.h"
+
+using namespace std::string_literals;
+
+void QueryExplanation::PrintText(std::ostream& out) const {
+    out << (is_parallel ? "par"s : "seq"s) << " query over "s << range_count << (range_count == 1 ? " range"s : " ranges"s)
+        << ", "s << documents.size() << " documents in "s << total_nanoseconds << " ns"s << '\n';
+    for (const Term& term : plus_terms) {
+        out << "plus word \""s << term.word << "\": "s << term.posting_count << " postings, document freq "s
+            << term.document_freq << ", idf "s << term.inverse_document_freq << '\n';
+    }
+    for (const Term& term : minus_terms) {
+        out << "minus word \""s << term.word << "\": "s << term.posting_count << " postings, document freq "s
+            << term.document_freq << '\n';
+    }
+    out << "postings scanned "s << stats.postings_scanned << ", documents scored "s << stats.documents_scored
+        << ", excluded by minus words "s << stats.documents_excluded << '\n';
+    bool is_first = true;
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        if (stats.has_phase[i]) {
+            out << (is_first ? ""s : ", "s) << GetQueryPhaseName(static_cast<QueryPhase>(i)) << ' ' << stats.phase_nanoseconds[i] << " ns"s;
+            is_first = false;
+        }
+    }
+    out << '\n';
+    for (const Document& document : documents) {
+        out << document << '\n';
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "document.h"
+#include "search_metrics.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// What SearchServer::ExplainTopDocuments found out about a query: its result together with
+// the parsed words, the cost of every phase and the execution path that was taken.
+struct QueryExplanation {
+    struct Term {
+        std::string word;
+        // postings in all the segments, including those of removed documents not merged away yet
+        size_t posting_count = 0;
+        int document_freq = 0;
+        // zero for the minus words and for the words no document has
+        double inverse_document_freq = 0.0;
+    };
+
+    std::vector<Document> documents;
+    std::vector<Term> plus_terms;
+    std::vector<Term> minus_terms;
+
+    bool is_parallel = false;
+    // the slot ranges scored separately, the phases of a par query are summed over them
+    size_t range_count = 1;
+    // the phase times and the postings scanned, documents scored and excluded by minus words
+    QueryStats stats;
+    uint64_t total_nanoseconds = 0;
+
+    // several lines for a person reading a slow query
+    void PrintText(std::ostream& out) const;
+};
@@ -0,0 +1,84 @@
+#include "query_result_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+    : shards_(std::max<size_t>(1, std::min(shard_count, capacity)))
+{
+    if (capacity == 0) {
+        throw std::invalid_argument("query result cache capacity must be positive"s);
+    }
+    shard_capacity_ = (capacity + shards_.size() - 1) / shards_.size();
+}
+
+std::optional<std::vector<Document>> QueryResultCache::Find(std::string_view key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++shard.miss_count;
+        return std::nullopt;
+    }
+    if (it->second->generation != generation) {
+        // computed on another version of the index, which is most likely an older one
+        ++shard.miss_count;
+        return std::nullopt;
+    }
+    ++shard.hit_count;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->documents;
+}
+
+void QueryResultCache::Insert(std::string key, uint64_t generation, std::vector<Document> documents) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        // a query on an older snapshot must not replace the result for a newer index
+        if (it->second->generation <= generation) {
+            it->second->generation = generation;
+            it->second->documents = std::move(documents);
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() == shard_capacity_) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({ std::move(key), generation, std::move(documents) });
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+void QueryResultCache::Clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+    }
+}
+
+uint64_t QueryResultCache::GetHitCount() const {
+    uint64_t hit_count = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        hit_count += shard.hit_count;
+    }
+    return hit_count;
+}
+
+uint64_t QueryResultCache::GetMissCount() const {
+    uint64_t miss_count = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        miss_count += shard.miss_count;
+    }
+    return miss_count;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(std::string_view key) {
+    return shards_[std::hash<std::string_view>{}(key) % shards_.size()];
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Bounded LRU cache of query results for SearchServer. Every result is stored with the
+// generation of the index it was computed on and a lookup with another generation misses,
+// so a changed index never serves stale results. The cache is split into shards with
+// their own locks and can be shared by concurrent queries and by copies of a server.
+class QueryResultCache {
+public:
+    explicit QueryResultCache(size_t capacity, size_t shard_count = 16);
+
+    std::optional<std::vector<Document>> Find(std::string_view key, uint64_t generation);
+    void Insert(std::string key, uint64_t generation, std::vector<Document> documents);
+    void Clear();
+
+    uint64_t GetHitCount() const;
+    uint64_t GetMissCount() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // the most recently used entry is at the front
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        uint64_t hit_count = 0;
+        uint64_t miss_count = 0;
+    };
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+
+    Shard& GetShard(std::string_view key);
+};
@@ -1,36 +1,330 @@
-#include <set>
-#include <vector>
-
 #include "remove_duplicates.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
 using namespace std;
 
-void RemoveDuplicates(SearchServer& search_server)
+namespace
 {
-    std::set<std::set<std::string>> unique_documents;
-    std::vector<int> ids_to_delete;
-    for (const int id : search_server) {
-        const map<std::string, double> word_freqs = search_server.GetWordFrequencies(id);
-        set<std::string> words;
-        transform(word_freqs.begin(), word_freqs.end(), inserter(words, words.begin()),
-            [](const pair<std::string, double> word)
-            {
-                return word.first;
-            });
 
-        if (unique_documents.count(words) == 0)
+using TermIds = vector<TermId>;
+
+constexpr size_t MIN_HASH_COUNT = 128;
+// the band keys of a pass over the documents take 8 bytes a document and band
+constexpr size_t BANDS_PER_PASS = 4;
+constexpr uint32_t NO_MEMBERSHIP = numeric_limits<uint32_t>::max();
+constexpr uint32_t NO_DOCUMENT = numeric_limits<uint32_t>::max();
+
+// the splitmix64 finalizer, it turns close inputs into unrelated hashes
+uint64_t MixHash(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+uint64_t HashTerm(TermId term_id)
+{
+    return MixHash(static_cast<uint64_t>(term_id));
+}
+
+// the terms of the document in a buffer of the calling thread, valid until its next call
+const TermIds& GetThreadDocumentTerms(const SearchServer& search_server, int document_id)
+{
+    thread_local TermIds term_ids;
+    search_server.GetDocumentTerms(document_id, term_ids);
+    return term_ids;
+}
+
+// the terms come sorted, so equal sets give equal fingerprints
+uint64_t ComputeFingerprint(const TermIds& term_ids)
+{
+    uint64_t fingerprint = term_ids.size();
+    for (const TermId term_id : term_ids)
+    {
+        fingerprint = MixHash(fingerprint ^ HashTerm(term_id));
+    }
+    return fingerprint;
+}
+
+double ComputeJaccardSimilarity(const TermIds& lhs, const TermIds& rhs)
+{
+    if (lhs.empty() && rhs.empty())
+    {
+        return 1.0;
+    }
+    size_t common_count = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end())
+    {
+        if (*lhs_it < *rhs_it)
+        {
+            ++lhs_it;
+        }
+        else if (*rhs_it < *lhs_it)
         {
-            unique_documents.insert(words);
+            ++rhs_it;
         }
         else
         {
-            ids_to_delete.push_back(id);
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common_count) / (lhs.size() + rhs.size() - common_count);
+}
+
+// Rows per LSH band. A pair with similarity s shares a band with probability
+// 1 - (1 - s^rows)^bands, whose steep part lies near (1 / bands)^(1 / rows). It is kept
+// well below the threshold, so pairs at the threshold are found almost surely.
+size_t ChooseBandRows(double jaccard_threshold)
+{
+    size_t best_rows = 1;
+    for (size_t rows = 1; rows <= MIN_HASH_COUNT; ++rows)
+    {
+        const double bands = static_cast<double>(MIN_HASH_COUNT / rows);
+        if (pow(1.0 / bands, 1.0 / rows) <= jaccard_threshold * 0.8)
+        {
+            best_rows = rows;
         }
     }
+    return best_rows;
+}
 
+void RemoveDocumentsVerbose(SearchServer& search_server, const vector<int>& ids_to_delete)
+{
     for (const int id : ids_to_delete)
     {
         cout << "Found duplicate document id " << id << endl;
-        search_server.RemoveDocument(id);
     }
+    search_server.RemoveDocuments(execution::par, ids_to_delete);
+}
+
+}  // namespace
+
+vector<int> FindDuplicates(const SearchServer& search_server)
+{
+    const vector<int> ids(search_server.begin(), search_server.end());
+    vector<uint64_t> fingerprints(ids.size());
+    transform(execution::par, ids.begin(), ids.end(), fingerprints.begin(), [&search_server](int id)
+        {
+            return ComputeFingerprint(GetThreadDocumentTerms(search_server, id));
+        });
+
+    // equal fingerprints end up next to each other, the smallest id first
+    vector<uint32_t> order(ids.size());
+    iota(order.begin(), order.end(), uint32_t{ 0 });
+    sort(execution::par, order.begin(), order.end(), [&fingerprints](uint32_t lhs, uint32_t rhs)
+        {
+            return fingerprints[lhs] < fingerprints[rhs] || (fingerprints[lhs] == fingerprints[rhs] && lhs < rhs);
+        });
+
+    vector<int> duplicates;
+    vector<uint32_t> kept;
+    TermIds term_ids;
+    TermIds kept_term_ids;
+    for (size_t group_begin = 0; group_begin < order.size();)
+    {
+        size_t group_end = group_begin + 1;
+        while (group_end < order.size() && fingerprints[order[group_end]] == fingerprints[order[group_begin]])
+        {
+            ++group_end;
+        }
+        // a group holds several distinct sets only on a hash collision
+        kept.assign(1, order[group_begin]);
+        for (size_t i = group_begin + 1; i < group_end; ++i)
+        {
+            search_server.GetDocumentTerms(ids[order[i]], term_ids);
+            const bool is_duplicate = any_of(kept.begin(), kept.end(), [&](uint32_t document)
+                {
+                    search_server.GetDocumentTerms(ids[document], kept_term_ids);
+                    return kept_term_ids == term_ids;
+                });
+            if (is_duplicate)
+            {
+                duplicates.push_back(ids[order[i]]);
+            }
+            else
+            {
+                kept.push_back(order[i]);
+            }
+        }
+        group_begin = group_end;
+    }
+
+    sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+vector<int> FindNearDuplicates(const SearchServer& search_server, double jaccard_threshold)
+{
+    if (!(jaccard_threshold > 0.0 && jaccard_threshold <= 1.0))
+    {
+        throw invalid_argument("the Jaccard threshold must be in (0, 1]"s);
+    }
+
+    const vector<int> ids(search_server.begin(), search_server.end());
+    const size_t document_count = ids.size();
+    const size_t band_rows = ChooseBandRows(jaccard_threshold);
+    const size_t band_count = MIN_HASH_COUNT / band_rows;
+
+    // a document belongs to the bucket of its key in every band, only the buckets of
+    // several documents are kept
+    struct Membership
+    {
+        uint32_t document;
+        uint32_t bucket;
+    };
+    vector<Membership> memberships;
+    uint32_t bucket_count = 0;
+
+    // the MinHash signature is computed a few bands at a time and reduced to one key per band
+    vector<uint64_t> band_keys;
+    vector<uint32_t> order(document_count);
+    vector<size_t> documents(document_count);
+    iota(documents.begin(), documents.end(), size_t{ 0 });
+    for (size_t first_band = 0; first_band < band_count; first_band += BANDS_PER_PASS)
+    {
+        const size_t pass_band_count = min(BANDS_PER_PASS, band_count - first_band);
+        band_keys.resize(document_count * pass_band_count);
+        for_each(execution::par, documents.begin(), documents.end(), [&](size_t document)
+            {
+                const size_t first_hash = first_band * band_rows;
+                const size_t hash_count = pass_band_count * band_rows;
+                uint64_t signature[MIN_HASH_COUNT];
+                fill(signature, signature + hash_count, numeric_limits<uint64_t>::max());
+                for (const TermId term_id : GetThreadDocumentTerms(search_server, ids[document]))
+                {
+                    const uint64_t term_hash = HashTerm(term_id);
+                    for (size_t i = 0; i < hash_count; ++i)
+                    {
+                        signature[i] = min(signature[i], MixHash(term_hash + (first_hash + i) * 0x9E3779B97F4A7C15ull));
+                    }
+                }
+                for (size_t band = 0; band < pass_band_count; ++band)
+                {
+                    uint64_t key = first_band + band;
+                    for (size_t row = 0; row < band_rows; ++row)
+                    {
+                        key = MixHash(key ^ signature[band * band_rows + row]);
+                    }
+                    band_keys[document * pass_band_count + band] = key;
+                }
+            });
+
+        for (size_t band = 0; band < pass_band_count; ++band)
+        {
+            const auto key = [&](uint32_t document)
+            {
+                return band_keys[document * pass_band_count + band];
+            };
+            iota(order.begin(), order.end(), uint32_t{ 0 });
+            sort(execution::par, order.begin(), order.end(), [&key](uint32_t lhs, uint32_t rhs)
+                {
+                    return key(lhs) < key(rhs) || (key(lhs) == key(rhs) && lhs < rhs);
+                });
+            for (size_t bucket_begin = 0; bucket_begin < order.size();)
+            {
+                size_t bucket_end = bucket_begin + 1;
+                while (bucket_end < order.size() && key(order[bucket_end]) == key(order[bucket_begin]))
+                {
+                    ++bucket_end;
+                }
+                if (bucket_end - bucket_begin > 1)
+                {
+                    for (size_t i = bucket_begin; i < bucket_end; ++i)
+                    {
+                        memberships.push_back({ order[i], bucket_count });
+                    }
+                    ++bucket_count;
+                }
+                bucket_begin = bucket_end;
+            }
+        }
+    }
+    band_keys = {};
+    order = {};
+    documents = {};
+    sort(execution::par, memberships.begin(), memberships.end(), [](const Membership& lhs, const Membership& rhs)
+        {
+            return lhs.document < rhs.document || (lhs.document == rhs.document && lhs.bucket < rhs.bucket);
+        });
+
+    // the kept documents of every bucket are chained from the last one through their
+    // memberships, documents go by ascending id, so a document is compared only with the
+    // kept ones before it
+    vector<uint32_t> last_kept(bucket_count, NO_MEMBERSHIP);
+    vector<uint32_t> previous_kept(memberships.size(), NO_MEMBERSHIP);
+    vector<uint32_t> compared_with(document_count, NO_DOCUMENT);
+    vector<int> duplicates;
+    TermIds term_ids;
+    TermIds kept_term_ids;
+    for (size_t first_membership = 0; first_membership < memberships.size();)
+    {
+        const uint32_t document = memberships[first_membership].document;
+        size_t end_membership = first_membership + 1;
+        while (end_membership < memberships.size() && memberships[end_membership].document == document)
+        {
+            ++end_membership;
+        }
+
+        bool has_terms = false;
+        bool is_duplicate = false;
+        for (size_t membership = first_membership; membership < end_membership && !is_duplicate; ++membership)
+        {
+            for (uint32_t kept = last_kept[memberships[membership].bucket]; kept != NO_MEMBERSHIP && !is_duplicate;
+                 kept = previous_kept[kept])
+            {
+                // a pair sharing several bands is compared once
+                const uint32_t kept_document = memberships[kept].document;
+                if (compared_with[kept_document] == document)
+                {
+                    continue;
+                }
+                compared_with[kept_document] = document;
+                if (!has_terms)
+                {
+                    search_server.GetDocumentTerms(ids[document], term_ids);
+                    has_terms = true;
+                }
+                search_server.GetDocumentTerms(ids[kept_document], kept_term_ids);
+                is_duplicate = ComputeJaccardSimilarity(term_ids, kept_term_ids) >= jaccard_threshold;
+            }
+        }
+        if (is_duplicate)
+        {
+            duplicates.push_back(ids[document]);
+        }
+        else
+        {
+            for (size_t membership = first_membership; membership < end_membership; ++membership)
+            {
+                uint32_t& bucket_last_kept = last_kept[memberships[membership].bucket];
+                previous_kept[membership] = bucket_last_kept;
+                bucket_last_kept = static_cast<uint32_t>(membership);
+            }
+        }
+        first_membership = end_membership;
+    }
+    return duplicates;
+}
+
+void RemoveDuplicates(SearchServer& search_server)
+{
+    RemoveDocumentsVerbose(search_server, FindDuplicates(search_server));
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, double jaccard_threshold)
+{
+    RemoveDocumentsVerbose(search_server, FindNearDuplicates(search_server, jaccard_threshold));
 }
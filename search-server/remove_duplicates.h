@@ -2,4 +2,23 @@
 
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+#include <vector>
+
+// Removes every document whose set of words equals the set of a document with a smaller id.
+void RemoveDuplicates(SearchServer& search_server);
+
+// Removes every document whose word set has a Jaccard similarity of at least
+// jaccard_threshold, in (0, 1], with a kept document of a smaller id.
+void RemoveNearDuplicates(SearchServer& search_server, double jaccard_threshold);
+
+// The ids RemoveDuplicates would remove, in ascending order. The documents are hashed
+// into 64-bit fingerprints of their term sets in parallel, and only documents with
+// equal fingerprints are compared term by term.
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// The ids RemoveNearDuplicates would remove, in ascending order. Candidates come from
+// MinHash signatures split into LSH bands, and every candidate pair is checked exactly,
+// so a near duplicate may be missed with a small probability but never reported falsely.
+// The terms of a document are read again for each few bands instead of being kept, and
+// only the buckets of several documents are stored.
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double jaccard_threshold);
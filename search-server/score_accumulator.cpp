@@ -0,0 +1,14 @@
+#include "score_accumulator.h"
+
+void ScoreAccumulator::Reset(size_t slot_count) {
+    for (const int slot : touched_slots_) {
+        scores_[slot] = 0.0;
+        marks_[slot] = UNTOUCHED;
+    }
+    touched_slots_.clear();
+
+    if (scores_.size() < slot_count) {
+        scores_.resize(slot_count, 0.0);
+        marks_.resize(slot_count, UNTOUCHED);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Flat relevance accumulator indexed by document slot. Only the touched slots
+// are reset between queries, so one instance is reused for the whole thread.
+class ScoreAccumulator {
+public:
+    void Reset(size_t slot_count);
+
+    void Add(int slot, double score);
+    void Exclude(int slot);
+    bool IsExcluded(int slot) const;
+
+    template <typename Function>
+    void ForEachScored(Function function) const;
+
+private:
+    enum Mark : uint8_t {
+        UNTOUCHED = 0,
+        SCORED = 1,
+        EXCLUDED = 2
+    };
+
+    std::vector<double> scores_;
+    std::vector<uint8_t> marks_;
+    std::vector<int> touched_slots_;
+};
+
+inline void ScoreAccumulator::Add(int slot, double score) {
+    if (marks_[slot] == UNTOUCHED) {
+        marks_[slot] = SCORED;
+        touched_slots_.push_back(slot);
+    }
+    scores_[slot] += score;
+}
+
+inline void ScoreAccumulator::Exclude(int slot) {
+    if (marks_[slot] == UNTOUCHED) {
+        touched_slots_.push_back(slot);
+    }
+    marks_[slot] = EXCLUDED;
+}
+
+inline bool ScoreAccumulator::IsExcluded(int slot) const {
+    return marks_[slot] == EXCLUDED;
+}
+
+template <typename Function>
+void ScoreAccumulator::ForEachScored(Function function) const {
+    for (const int slot : touched_slots_) {
+        if (marks_[slot] == SCORED) {
+            function(slot, scores_[slot]);
+        }
+    }
+}
@@ -0,0 +1,241 @@
+#include "search_metrics.h"
+
+#include <exception>
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr std::array<std::string_view, QUERY_PHASE_COUNT> PHASE_NAMES = {
+    "parse", "posting_traversal", "scoring", "top_k", "match"
+};
+
+constexpr std::array<std::string_view, QUERY_COUNTER_COUNT> COUNTER_NAMES = {
+    "searches", "matches", "postings_scanned", "documents_scored", "documents_excluded"
+};
+
+constexpr std::array<double, 4> PRINTED_PERCENTILES = { 50.0, 90.0, 99.0, 99.9 };
+constexpr std::array<std::string_view, 4> PERCENTILE_NAMES = { "p50", "p90", "p99", "p999" };
+
+void PrintHistogramText(std::ostream& out, std::string_view name, const HistogramSnapshot& histogram) {
+    out << name << ": count "s << histogram.GetCount() << ", mean "s << static_cast<uint64_t>(histogram.GetMean())
+        << " ns, min "s << histogram.GetMin() << " ns"s;
+    for (size_t i = 0; i < PRINTED_PERCENTILES.size(); ++i) {
+        out << ", "s << PERCENTILE_NAMES[i] << ' ' << histogram.GetValueAtPercentile(PRINTED_PERCENTILES[i]) << " ns"s;
+    }
+    out << ", max "s << histogram.GetMax() << " ns"s << '\n';
+}
+
+void PrintJsonString(std::ostream& out, std::string_view text) {
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    out << '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u00"s << HEX_DIGITS[c >> 4] << HEX_DIGITS[c & 0xF];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void PrintHistogramJson(std::ostream& out, std::string_view name, const HistogramSnapshot& histogram) {
+    PrintJsonString(out, name);
+    out << ": {\"count\": "s << histogram.GetCount() << ", \"mean_ns\": "s << histogram.GetMean()
+        << ", \"min_ns\": "s << histogram.GetMin();
+    for (size_t i = 0; i < PRINTED_PERCENTILES.size(); ++i) {
+        out << ", \""s << PERCENTILE_NAMES[i] << "_ns\": "s << histogram.GetValueAtPercentile(PRINTED_PERCENTILES[i]);
+    }
+    out << ", \"max_ns\": "s << histogram.GetMax() << '}';
+}
+
+}  // namespace
+
+std::string_view GetQueryPhaseName(QueryPhase phase) {
+    return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+std::string_view GetQueryCounterName(QueryCounter counter) {
+    return COUNTER_NAMES[static_cast<size_t>(counter)];
+}
+
+void QueryStats::AddPhase(QueryPhase phase, Clock::duration duration) {
+    const size_t index = static_cast<size_t>(phase);
+    phase_nanoseconds[index] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    has_phase[index] = true;
+}
+
+void QueryStats::Merge(const QueryStats& other) {
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        phase_nanoseconds[i] += other.phase_nanoseconds[i];
+        has_phase[i] = has_phase[i] || other.has_phase[i];
+    }
+    postings_scanned += other.postings_scanned;
+    documents_scored += other.documents_scored;
+    documents_excluded += other.documents_excluded;
+}
+
+uint64_t MetricsSnapshot::GetCounter(QueryCounter counter) const {
+    return counters[static_cast<size_t>(counter)];
+}
+
+const HistogramSnapshot& MetricsSnapshot::GetPhase(QueryPhase phase) const {
+    return phases[static_cast<size_t>(phase)];
+}
+
+void MetricsSnapshot::PrintText(std::ostream& out) const {
+    for (size_t i = 0; i < QUERY_COUNTER_COUNT; ++i) {
+        out << COUNTER_NAMES[i] << ": "s << counters[i] << '\n';
+    }
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        PrintHistogramText(out, PHASE_NAMES[i], phases[i]);
+    }
+    for (const auto& [name, histogram] : histograms) {
+        PrintHistogramText(out, name, histogram);
+    }
+}
+
+void MetricsSnapshot::PrintJson(std::ostream& out) const {
+    out << "{\"counters\": {"s;
+    for (size_t i = 0; i < QUERY_COUNTER_COUNT; ++i) {
+        out << (i == 0 ? ""s : ", "s) << '"' << COUNTER_NAMES[i] << "\": "s << counters[i];
+    }
+    out << "}, \"phases\": {"s;
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        out << (i == 0 ? ""s : ", "s);
+        PrintHistogramJson(out, PHASE_NAMES[i], phases[i]);
+    }
+    out << "}, \"histograms\": {"s;
+    bool is_first = true;
+    for (const auto& [name, histogram] : histograms) {
+        out << (is_first ? ""s : ", "s);
+        is_first = false;
+        PrintHistogramJson(out, name, histogram);
+    }
+    out << "}}"s;
+}
+
+MetricsRegistry& MetricsRegistry::Instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void MetricsRegistry::SetEnabled(bool enabled) {
+    is_enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+bool MetricsRegistry::IsEnabled() const noexcept {
+    return is_enabled_.load(std::memory_order_relaxed);
+}
+
+void MetricsRegistry::AddCount(QueryCounter counter, uint64_t value) {
+    GetThreadMetrics().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::RecordPhase(QueryPhase phase, uint64_t nanoseconds) {
+    GetThreadMetrics().phases[static_cast<size_t>(phase)].Record(nanoseconds);
+}
+
+void MetricsRegistry::RecordQuery(QueryCounter kind, const QueryStats& stats) {
+    ThreadMetrics& metrics = GetThreadMetrics();
+    metrics.counters[static_cast<size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+    metrics.counters[static_cast<size_t>(QueryCounter::POSTINGS_SCANNED)].fetch_add(stats.postings_scanned, std::memory_order_relaxed);
+    metrics.counters[static_cast<size_t>(QueryCounter::DOCUMENTS_SCORED)].fetch_add(stats.documents_scored, std::memory_order_relaxed);
+    metrics.counters[static_cast<size_t>(QueryCounter::DOCUMENTS_EXCLUDED)].fetch_add(stats.documents_excluded, std::memory_order_relaxed);
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        if (stats.has_phase[i]) {
+            metrics.phases[i].Record(stats.phase_nanoseconds[i]);
+        }
+    }
+}
+
+LatencyHistogram& MetricsRegistry::GetHistogram(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    auto it = histograms_.find(name);
+    if (it == histograms_.end()) {
+        it = histograms_.emplace(std::string(name), std::make_unique<LatencyHistogram>()).first;
+    }
+    return *it->second;
+}
+
+MetricsSnapshot MetricsRegistry::TakeSnapshot() const {
+    MetricsSnapshot snapshot;
+    std::lock_guard guard(mutex_);
+    for (const auto& metrics : thread_metrics_) {
+        for (size_t i = 0; i < QUERY_COUNTER_COUNT; ++i) {
+            snapshot.counters[i] += metrics->counters[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+            snapshot.phases[i].Merge(metrics->phases[i]);
+        }
+    }
+    for (const auto& [name, histogram] : histograms_) {
+        snapshot.histograms[name].Merge(*histogram);
+    }
+    return snapshot;
+}
+
+void MetricsRegistry::Reset() {
+    std::lock_guard guard(mutex_);
+    for (const auto& metrics : thread_metrics_) {
+        for (auto& counter : metrics->counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (LatencyHistogram& histogram : metrics->phases) {
+            histogram.Reset();
+        }
+    }
+    for (const auto& [name, histogram] : histograms_) {
+        histogram->Reset();
+    }
+}
+
+MetricsRegistry::ThreadMetrics& MetricsRegistry::GetThreadMetrics() {
+    // gives the block back when the thread ends
+    struct ThreadBlock {
+        ThreadMetrics* metrics = nullptr;
+
+        ~ThreadBlock() {
+            if (metrics != nullptr) {
+                MetricsRegistry::Instance().ReleaseThreadMetrics(metrics);
+            }
+        }
+    };
+
+    thread_local ThreadBlock block;
+    if (block.metrics == nullptr) {
+        block.metrics = AcquireThreadMetrics();
+    }
+    return *block.metrics;
+}
+
+MetricsRegistry::ThreadMetrics* MetricsRegistry::AcquireThreadMetrics() {
+    std::lock_guard guard(mutex_);
+    if (!free_thread_metrics_.empty()) {
+        ThreadMetrics* metrics = free_thread_metrics_.back();
+        free_thread_metrics_.pop_back();
+        return metrics;
+    }
+    thread_metrics_.push_back(std::make_unique<ThreadMetrics>());
+    return thread_metrics_.back().get();
+}
+
+void MetricsRegistry::ReleaseThreadMetrics(ThreadMetrics* metrics) {
+    std::lock_guard guard(mutex_);
+    free_thread_metrics_.push_back(metrics);
+}
+
+QueryRecorder::QueryRecorder(QueryCounter kind)
+    : kind_(kind)
+    , is_enabled_(MetricsRegistry::Instance().IsEnabled())
+    , uncaught_exception_count_(std::uncaught_exceptions())
+{
+}
+
+QueryRecorder::~QueryRecorder() {
+    if (is_enabled_ && std::uncaught_exceptions() == uncaught_exception_count_) {
+        MetricsRegistry::Instance().RecordQuery(kind_, stats_);
+    }
+}
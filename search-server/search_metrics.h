@@ -0,0 +1,178 @@
+#pragma once
+
+#include "latency_histogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the spans of a query, the registry keeps a histogram for each
+enum class QueryPhase {
+    // query words split, checked and looked up in the dictionary
+    PARSE,
+    // postings of the minus words walked to exclude their documents
+    POSTING_TRAVERSAL,
+    // postings of the plus words walked and the relevance summed
+    SCORING,
+    // the scored documents ranked into the result
+    TOP_K,
+    // MatchDocument as a whole
+    MATCH
+};
+
+constexpr size_t QUERY_PHASE_COUNT = 5;
+
+enum class QueryCounter {
+    SEARCHES,
+    MATCHES,
+    POSTINGS_SCANNED,
+    DOCUMENTS_SCORED,
+    // reached through the plus words and dropped for a minus word
+    DOCUMENTS_EXCLUDED
+};
+
+constexpr size_t QUERY_COUNTER_COUNT = 5;
+
+std::string_view GetQueryPhaseName(QueryPhase phase);
+std::string_view GetQueryCounterName(QueryCounter counter);
+
+// What one query did. The search fills it while the metrics are on or the query is explained.
+struct QueryStats {
+    using Clock = std::chrono::steady_clock;
+
+    std::array<uint64_t, QUERY_PHASE_COUNT> phase_nanoseconds{};
+    // the phases the query went through, only they are recorded
+    std::array<bool, QUERY_PHASE_COUNT> has_phase{};
+    uint64_t postings_scanned = 0;
+    uint64_t documents_scored = 0;
+    uint64_t documents_excluded = 0;
+
+    void AddPhase(QueryPhase phase, Clock::duration duration);
+    // adds the stats of one range of a parallel query
+    void Merge(const QueryStats& other);
+};
+
+// Adds the time until Stop or destruction to a phase of the stats, does nothing for null stats.
+class PhaseTimer {
+public:
+    using Clock = QueryStats::Clock;
+
+    PhaseTimer(QueryStats* stats, QueryPhase phase)
+        : stats_(stats)
+        , phase_(phase)
+    {
+        if (stats_ != nullptr) {
+            start_time_ = Clock::now();
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    ~PhaseTimer() {
+        Stop();
+    }
+
+    void Stop() {
+        if (stats_ != nullptr) {
+            stats_->AddPhase(phase_, Clock::now() - start_time_);
+            stats_ = nullptr;
+        }
+    }
+
+private:
+    QueryStats* stats_;
+    QueryPhase phase_;
+    Clock::time_point start_time_;
+};
+
+struct MetricsSnapshot {
+    std::array<uint64_t, QUERY_COUNTER_COUNT> counters{};
+    std::array<HistogramSnapshot, QUERY_PHASE_COUNT> phases;
+    // the histograms taken by name from the registry
+    std::map<std::string, HistogramSnapshot, std::less<>> histograms;
+
+    uint64_t GetCounter(QueryCounter counter) const;
+    const HistogramSnapshot& GetPhase(QueryPhase phase) const;
+
+    // one line per counter and per histogram
+    void PrintText(std::ostream& out) const;
+    void PrintJson(std::ostream& out) const;
+};
+
+// Process-wide metrics of the search hot paths. Every thread records into a block of
+// counters and histograms of its own, so recording takes no lock and no cache line is
+// written by two threads; a snapshot merges the blocks. The block of a finished thread
+// keeps its counts and is handed to the next new thread.
+class MetricsRegistry {
+public:
+    static MetricsRegistry& Instance();
+
+    // off by default, the queries then read no clock
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const noexcept;
+
+    void AddCount(QueryCounter counter, uint64_t value);
+    void RecordPhase(QueryPhase phase, uint64_t nanoseconds);
+    // counts the query as kind, SEARCHES or MATCHES, and records its phases and counters
+    void RecordQuery(QueryCounter kind, const QueryStats& stats);
+
+    // a histogram by name for the timings outside the queries, e.g. LOG_DURATION_HISTOGRAM;
+    // the reference stays valid for the life of the process
+    LatencyHistogram& GetHistogram(std::string_view name);
+
+    MetricsSnapshot TakeSnapshot() const;
+    // concurrent records may be kept
+    void Reset();
+
+private:
+    struct alignas(64) ThreadMetrics {
+        std::array<std::atomic<uint64_t>, QUERY_COUNTER_COUNT> counters{};
+        std::array<LatencyHistogram, QUERY_PHASE_COUNT> phases;
+    };
+
+    std::atomic<bool> is_enabled_{ false };
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadMetrics>> thread_metrics_;
+    // blocks of the finished threads
+    std::vector<ThreadMetrics*> free_thread_metrics_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>, std::less<>> histograms_;
+
+    MetricsRegistry() = default;
+
+    ThreadMetrics& GetThreadMetrics();
+    ThreadMetrics* AcquireThreadMetrics();
+    void ReleaseThreadMetrics(ThreadMetrics* metrics);
+};
+
+// Stats of one query, recorded into the registry when the query returns. With the
+// metrics off GetStats is null, so the query neither reads the clock nor records.
+class QueryRecorder {
+public:
+    explicit QueryRecorder(QueryCounter kind);
+
+    QueryRecorder(const QueryRecorder&) = delete;
+    QueryRecorder& operator=(const QueryRecorder&) = delete;
+
+    // a query ended by an exception is not recorded
+    ~QueryRecorder();
+
+    QueryStats* GetStats() noexcept {
+        return is_enabled_ ? &stats_ : nullptr;
+    }
+
+private:
+    QueryCounter kind_;
+    bool is_enabled_;
+    int uncaught_exception_count_;
+    QueryStats stats_;
+};
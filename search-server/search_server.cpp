@@ -1,73 +1,365 @@
 #include "search_server.h"
+#include "index_snapshot.h"
+
+#include <cstring>
+#include <numeric>
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if (document_id < 0) {
-        throw std::invalid_argument("id cannot be odd"s);
+    ValidateNewDocumentId(document_id);
+    const auto words = SplitIntoWordsNoStop(document);
+
+    std::vector<TermId> term_ids;
+    term_ids.reserve(words.size());
+    for (const auto word : words) {
+        term_ids.push_back(terms_.Intern(word));
     }
-    if (documents_.count(document_id)) {
-        throw std::invalid_argument("this id already exists"s);
+    ResizePostings();
+    std::sort(term_ids.begin(), term_ids.end());
+
+    const int slot = static_cast<int>(slots_.Size());
+    const int rating = SearchServer::ComputeAverageRating(ratings);
+    slots_.PushBack({ document_id, rating, status });
+
+    auto word_freqs = std::make_shared<std::map<std::string_view, double>>();
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const auto term_end = std::upper_bound(it, term_ids.end(), *it);
+        const int term_count = static_cast<int>(term_end - it);
+        const double term_freq = static_cast<double>(term_count) / words.size();
+        postings_.Mutable(*it).Add(slot, term_count, static_cast<int>(words.size()));
+        ++document_freqs_.Mutable(*it);
+        word_freqs->emplace(terms_.GetWord(*it), term_freq);
+        it = term_end;
     }
-    if (!IsValidWord(document)) {
-        throw std::invalid_argument("there are forbidden symbols in the word"s);
+
+    added_slots_.Insert(document_id, slot);
+    added_documents_.PushBack({ texts_.Store(document), std::move(word_freqs) });
+    generation_ = NextIndexGeneration();
+    UpdateLogCounts();
+    SealSegmentIfFull();
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocumentBatch(std::execution::seq, documents, nullptr);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents, nullptr);
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy& policy, const std::vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents, nullptr);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<NewDocument>& documents,
+                                const RejectDocument& reject) {
+    AddDocumentBatch(policy, documents, &reject);
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy& policy, const std::vector<NewDocument>& documents,
+                                const RejectDocument& reject) {
+    AddDocumentBatch(policy, documents, &reject);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentBatch(ExecutionPolicy&& policy, const std::vector<NewDocument>& documents, const RejectDocument* reject) {
+    std::vector<bool> is_rejected(documents.size(), false);
+    const auto reject_document = [reject, &is_rejected](size_t index, const std::string& reason) {
+        if (reject == nullptr) {
+            throw std::invalid_argument(reason);
+        }
+        (*reject)(index, reason);
+        is_rejected[index] = true;
+    };
+    for (size_t i = 0; i < documents.size(); ++i) {
+        try {
+            ValidateNewDocumentId(documents[i].id);
+        } catch (const std::invalid_argument& e) {
+            reject_document(i, e.what());
+        }
     }
 
-    auto words = SplitIntoWordsNoStop(document);
-    const std::string document_string{ document };
-    documents_.emplace(document_id, DocumentData{ SearchServer::ComputeAverageRating(ratings), status, document_string });
-    
-    words = SplitIntoWordsNoStop(documents_.at(document_id).text_);
-    
-    for (auto word : words) {
-        ids_to_document_freqs_[word][document_id] += 1.0 / words.size();
-        ids_to_word_freqs_[document_id][word] += 1.0 / words.size();
+    struct DocumentTerms {
+        std::vector<std::string_view> words;
+        std::vector<TermId> term_ids;
+        std::vector<int> term_counts;
+        int word_count = 0;
+        bool is_valid = true;
+    };
+
+    // tokenizing and counting only reads the dictionary, so documents are handled concurrently
+    std::vector<DocumentTerms> batch_terms(documents.size());
+    std::transform(policy, documents.begin(), documents.end(), batch_terms.begin(),
+        [this](const NewDocument& document) {
+            DocumentTerms result;
+            // an exception must not leave a parallel algorithm, the batch is rejected below instead
+            try {
+                result.words = SplitIntoWordsNoStop(document.text);
+            } catch (const std::invalid_argument&) {
+                result.is_valid = false;
+                return result;
+            }
+            result.word_count = static_cast<int>(result.words.size());
+            std::sort(result.words.begin(), result.words.end());
+            size_t unique_count = 0;
+            for (size_t i = 0; i < result.words.size(); ++i) {
+                if (unique_count > 0 && result.words[unique_count - 1] == result.words[i]) {
+                    ++result.term_counts.back();
+                    continue;
+                }
+                result.words[unique_count++] = result.words[i];
+                result.term_ids.push_back(terms_.Find(result.words[i]));
+                result.term_counts.push_back(1);
+            }
+            result.words.resize(unique_count);
+            return result;
+        });
+    // a repeated id is checked after the texts, so the first valid document with the id is kept
+    std::set<int> batch_ids;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (is_rejected[i]) {
+            continue;
+        }
+        if (!batch_terms[i].is_valid) {
+            reject_document(i, "there are forbidden symbols in the word"s);
+        } else if (!batch_ids.insert(documents[i].id).second) {
+            reject_document(i, "this id already exists"s);
+        }
     }
-    
-    document_ids_.emplace(document_id);
+    std::vector<const NewDocument*> added_documents;
+    added_documents.reserve(documents.size());
+    size_t added_count = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (is_rejected[i]) {
+            continue;
+        }
+        added_documents.push_back(&documents[i]);
+        if (added_count != i) {
+            batch_terms[added_count] = std::move(batch_terms[i]);
+        }
+        ++added_count;
+    }
+    batch_terms.resize(added_count);
+
+    // only the words that are new to the dictionary are interned here
+    for (DocumentTerms& document_terms : batch_terms) {
+        for (size_t i = 0; i < document_terms.words.size(); ++i) {
+            if (document_terms.term_ids[i] == TermDictionary::NO_TERM) {
+                document_terms.term_ids[i] = terms_.Intern(document_terms.words[i]);
+            }
+        }
+    }
+    ResizePostings();
+
+    const int first_slot = static_cast<int>(slots_.Size());
+    std::vector<std::shared_ptr<std::map<std::string_view, double>>> batch_word_freqs;
+    batch_word_freqs.reserve(added_documents.size());
+    for (const NewDocument* added_document : added_documents) {
+        const NewDocument& document = *added_document;
+        const int rating = SearchServer::ComputeAverageRating(document.ratings);
+        added_slots_.Insert(document.id, static_cast<int>(slots_.Size()));
+        slots_.PushBack({ document.id, rating, document.status });
+        batch_word_freqs.push_back(std::make_shared<std::map<std::string_view, double>>());
+        added_documents_.PushBack({ texts_.Store(document.text), batch_word_freqs.back() });
+    }
+
+    // group the new postings by term, each group is already in slot order
+    struct NewPosting {
+        int slot;
+        int term_count;
+        int document_length;
+    };
+    std::vector<size_t> term_offsets(postings_.Size() + 1, 0);
+    for (const DocumentTerms& document_terms : batch_terms) {
+        for (const TermId term_id : document_terms.term_ids) {
+            ++term_offsets[term_id + 1];
+        }
+    }
+    for (size_t term_id = 0; term_id < postings_.Size(); ++term_id) {
+        term_offsets[term_id + 1] += term_offsets[term_id];
+    }
+    std::vector<NewPosting> new_postings(term_offsets.back());
+    std::vector<size_t> term_positions(term_offsets.begin(), term_offsets.end() - 1);
+    std::vector<TermId> touched_terms;
+    for (size_t i = 0; i < batch_terms.size(); ++i) {
+        const DocumentTerms& document_terms = batch_terms[i];
+        for (size_t j = 0; j < document_terms.term_ids.size(); ++j) {
+            const TermId term_id = document_terms.term_ids[j];
+            if (term_positions[term_id] == term_offsets[term_id]) {
+                touched_terms.push_back(term_id);
+            }
+            new_postings[term_positions[term_id]++] = { first_slot + static_cast<int>(i), document_terms.term_counts[j], document_terms.word_count };
+        }
+    }
+
+    // the shared chunks are copied here, not by the concurrent tasks below
+    std::vector<PostingList*> touched_postings;
+    touched_postings.reserve(touched_terms.size());
+    for (const TermId term_id : touched_terms) {
+        touched_postings.push_back(&postings_.Mutable(term_id));
+        document_freqs_.Mutable(term_id) += static_cast<int>(term_offsets[term_id + 1] - term_offsets[term_id]);
+    }
+
+    // every posting list and every word map belongs to a single task
+    std::vector<size_t> touched_indexes(touched_terms.size());
+    std::iota(touched_indexes.begin(), touched_indexes.end(), size_t{ 0 });
+    std::for_each(policy, touched_indexes.begin(), touched_indexes.end(),
+        [&touched_terms, &touched_postings, &term_offsets, &new_postings](size_t index) {
+            const TermId term_id = touched_terms[index];
+            PostingList& postings = *touched_postings[index];
+            for (size_t i = term_offsets[term_id]; i < term_offsets[term_id + 1]; ++i) {
+                postings.Add(new_postings[i].slot, new_postings[i].term_count, new_postings[i].document_length);
+            }
+        });
+    std::vector<size_t> document_indexes(added_documents.size());
+    std::iota(document_indexes.begin(), document_indexes.end(), size_t{ 0 });
+    std::for_each(policy, document_indexes.begin(), document_indexes.end(),
+        [this, &batch_terms, &batch_word_freqs](size_t i) {
+            const DocumentTerms& document_terms = batch_terms[i];
+            for (size_t j = 0; j < document_terms.term_ids.size(); ++j) {
+                batch_word_freqs[i]->emplace(terms_.GetWord(document_terms.term_ids[j]),
+                                             static_cast<double>(document_terms.term_counts[j]) / document_terms.word_count);
+            }
+        });
+    generation_ = NextIndexGeneration();
+    UpdateLogCounts();
+    SealSegmentIfFull();
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query, status);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                     size_t max_document_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, max_document_count);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(const QueryControl& control, std::string_view raw_query, DocumentStatus status,
+                                                     size_t max_document_count) const {
+    return FindTopDocuments(control, raw_query,
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, max_document_count);
+}
+
+std::future<std::vector<Document>> SearchServer::FindTopDocumentsAsync(QueryControl control, std::string raw_query, DocumentStatus status,
+                                                                       size_t max_document_count) const {
+    return FindTopDocumentsAsync(std::move(control), std::move(raw_query),
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, max_document_count);
+}
+
+QueryExplanation SearchServer::ExplainTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_document_count) const {
+    return ExplainTopDocuments(std::execution::seq, raw_query, status, max_document_count);
+}
+
+void SearchServer::SetResultCache(std::shared_ptr<QueryResultCache> cache) {
+    result_cache_ = std::move(cache);
+}
+
+const std::shared_ptr<QueryResultCache>& SearchServer::GetResultCache() const {
+    return result_cache_;
+}
+
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query, DocumentStatus status,
+                                                            size_t max_document_count) const {
+    return FindTopDocuments(context, raw_query,
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, max_document_count);
+}
+
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return static_cast<int>(added_slots_.Size()) + snapshot_document_count_;
+}
+
+SearchServer::DocumentIdIterator SearchServer::begin() const noexcept {
+    return DocumentIdIterator(this, added_slots_.begin(), 0);
+}
+
+SearchServer::DocumentIdIterator SearchServer::end() const noexcept {
+    return DocumentIdIterator(this, added_slots_.end(), snapshot_documents_ ? snapshot_documents_->Size() : 0);
+}
+
+SearchServer::DocumentIdIterator::DocumentIdIterator(const SearchServer* server, PersistentIdMap<int>::Iterator added,
+                                                     size_t loaded_rank) noexcept
+    : server_(server)
+    , added_(added)
+    , loaded_rank_(loaded_rank)
+{
+    SkipRemovedLoaded();
+    UpdateDocumentId();
 }
 
-const std::set<int>::const_iterator SearchServer::begin() const noexcept {
-    return document_ids_.begin();
+SearchServer::DocumentIdIterator& SearchServer::DocumentIdIterator::operator++() noexcept {
+    const bool is_added = added_ != server_->added_slots_.end()
+                          && (loaded_rank_ == GetLoadedCount() || *added_ < GetLoadedId());
+    if (is_added) {
+        ++added_;
+    } else {
+        ++loaded_rank_;
+        SkipRemovedLoaded();
+    }
+    UpdateDocumentId();
+    return *this;
+}
+
+SearchServer::DocumentIdIterator SearchServer::DocumentIdIterator::operator++(int) noexcept {
+    DocumentIdIterator result = *this;
+    ++*this;
+    return result;
+}
+
+size_t SearchServer::DocumentIdIterator::GetLoadedCount() const noexcept {
+    return server_->snapshot_documents_ ? server_->snapshot_documents_->Size() : 0;
 }
 
-const std::set<int>::const_iterator SearchServer::end() const noexcept {
-    return document_ids_.end();
+int SearchServer::DocumentIdIterator::GetLoadedId() const noexcept {
+    const SnapshotDocuments& documents = *server_->snapshot_documents_;
+    return documents.GetRecord(documents.GetSlotByRank(loaded_rank_)).document_id;
+}
+
+void SearchServer::DocumentIdIterator::SkipRemovedLoaded() noexcept {
+    const size_t loaded_count = GetLoadedCount();
+    while (loaded_rank_ < loaded_count && server_->IsRemoved(server_->snapshot_documents_->GetSlotByRank(loaded_rank_))) {
+        ++loaded_rank_;
+    }
+}
+
+void SearchServer::DocumentIdIterator::UpdateDocumentId() noexcept {
+    if (loaded_rank_ < GetLoadedCount()) {
+        const int loaded_id = GetLoadedId();
+        document_id_ = added_ != server_->added_slots_.end() ? std::min(*added_, loaded_id) : loaded_id;
+    } else if (added_ != server_->added_slots_.end()) {
+        document_id_ = *added_;
+    }
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    QueryRecorder recorder(QueryCounter::MATCHES);
+    PhaseTimer match_timer(recorder.GetStats(), QueryPhase::MATCH);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
     const Query query = ParseQuery(raw_query);
+    parse_timer.Stop();
+    const DocumentData document_data = GetDocument(document_id);
+    const DocumentStatus status = document_data.status;
+    const int slot = document_data.slot;
 
-    std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.minus_words) {
-        if (ids_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (ids_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
-            return { {}, documents_.at(document_id).status };
+        if (ContainsWord(slot, word)) {
+            return { std::vector<std::string_view>{}, status };
         }
     }
+
+    std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.plus_words) {
-        if (ids_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (ids_to_document_freqs_.at(word).count(document_id)) {
+        if (ContainsWord(slot, word)) {
             matched_words.push_back(word);
         }
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, status };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const {
@@ -75,19 +367,26 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+    if ((document_id < 0) || !FindDocument(document_id)) {
             throw std::invalid_argument("document id is out of range"s);
         }
 
+    QueryRecorder recorder(QueryCounter::MATCHES);
+    PhaseTimer match_timer(recorder.GetStats(), QueryPhase::MATCH);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
     const Query& query = ParseQueryParallel(raw_query);
-    const auto& word_freqs = ids_to_word_freqs_.at(document_id);
-    
-    if (std::any_of(query.minus_words.begin(),
+    parse_timer.Stop();
+    const DocumentData document_data = GetDocument(document_id);
+    const DocumentStatus status = document_data.status;
+    const auto contains_word = [this, slot = document_data.slot](const std::string_view word) {
+        return ContainsWord(slot, word);
+    };
+
+    if (std::any_of(policy,
+                    query.minus_words.begin(),
                     query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
-                    })) {
-        return { {}, documents_.at(document_id).status };
+                    contains_word)) {
+        return { std::vector<std::string_view>{}, status };
     }
 
     std::vector<std::string_view> matched_words;
@@ -95,43 +394,456 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     std::copy_if(query.plus_words.begin(),
                  query.plus_words.end(),
                  std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
-                 });
+                 contains_word);
 
     std::sort(policy, matched_words.begin(), matched_words.end());
     auto it = std::unique(matched_words.begin(), matched_words.end());
     matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, status };
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const QueryControl& control, std::string_view raw_query, int document_id) const {
+    QueryRecorder recorder(QueryCounter::MATCHES);
+    PhaseTimer match_timer(recorder.GetStats(), QueryPhase::MATCH);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
+    const Query query = ParseQuery(raw_query);
+    parse_timer.Stop();
+    const DocumentData document_data = GetDocument(document_id);
+    const DocumentStatus status = document_data.status;
+    const int slot = document_data.slot;
+
+    for (const std::string_view word : query.minus_words) {
+        if (control.ShouldStop() || ContainsWord(slot, word)) {
+            return { std::vector<std::string_view>{}, status };
+        }
+    }
+
+    std::vector<std::string_view> matched_words;
+    for (const std::string_view word : query.plus_words) {
+        if (control.ShouldStop()) {
+            break;
+        }
+        if (ContainsWord(slot, word)) {
+            matched_words.push_back(word);
+        }
+    }
+
+    return { matched_words, status };
+}
+
+std::future<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocumentAsync(QueryControl control, std::string raw_query, int document_id) const {
+    return std::async(std::launch::async,
+        [this, control = std::move(control), raw_query = std::move(raw_query), document_id]() {
+            auto [matched_words, status] = MatchDocument(control, raw_query, document_id);
+            // the query dies with the task, the dictionary keeps the words
+            for (std::string_view& word : matched_words) {
+                word = terms_.GetWord(terms_.Find(word));
+            }
+            return std::tuple{ std::move(matched_words), status };
+        });
+}
+
+std::tuple<const std::vector<std::string_view>&, DocumentStatus> SearchServer::MatchDocument(QueryContext& context, std::string_view raw_query, int document_id) const {
+    QueryRecorder recorder(QueryCounter::MATCHES);
+    PhaseTimer match_timer(recorder.GetStats(), QueryPhase::MATCH);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
+    ParseQuery(raw_query, context.words_, context.query_);
+    parse_timer.Stop();
+    const DocumentData document_data = GetDocument(document_id);
+    const int slot = document_data.slot;
+    std::vector<std::string_view>& matched_words = context.matched_words_;
+    matched_words.clear();
+
+    for (const std::string_view word : context.query_.minus_words) {
+        if (ContainsWord(slot, word)) {
+            return { matched_words, document_data.status };
+        }
+    }
+    for (const std::string_view word : context.query_.plus_words) {
+        if (ContainsWord(slot, word)) {
+            matched_words.push_back(word);
+        }
+    }
+    return { matched_words, document_data.status };
 }
 
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     static const std::map<std::string_view, double> dummy;
-    if (ids_to_word_freqs_.count(document_id) == 0) {
+    if (const int* slot = added_slots_.Find(document_id)) {
+        return *added_documents_[*slot - first_added_slot_].word_freqs;
+    }
+    const auto document = FindDocument(document_id);
+    if (!document) {
         return dummy;
     }
-    else {
-        return ids_to_word_freqs_.at(document_id);
+    // a loaded document, its map is built from the text on first use
+    return snapshot_documents_->GetWordFrequencies(document->slot, [this](std::string_view text) {
+        return ComputeWordFrequencies(text);
+    });
+}
+
+void SearchServer::GetDocumentTerms(int document_id, std::vector<TermId>& term_ids) const {
+    const auto document = FindDocument(document_id);
+    if (!document) {
+        term_ids.clear();
+        return;
     }
+    GetDocumentTerms(*document, term_ids);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (ids_to_word_freqs_.count(document_id)) {
-        std::map<std::string_view, double> search_element = ids_to_word_freqs_[document_id];
+    RemoveDocument(std::execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    RemoveDocumentBatch(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::sequenced_policy& policy, const std::vector<int>& document_ids) {
+    RemoveDocumentBatch(policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::parallel_policy& policy, const std::vector<int>& document_ids) {
+    RemoveDocumentBatch(policy, document_ids);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentBatch(ExecutionPolicy&& policy, const std::vector<int>& document_ids) {
+    // as in RemoveDocument the postings stay until the segments are sealed or merged
+    std::vector<TermId> removed_terms;
+    std::vector<TermId> term_ids;
+    bool has_sealed_slots = false;
+    for (const int document_id : document_ids) {
+        const auto document = FindDocument(document_id);
+        if (!document) {
+            continue;
+        }
+        const int slot = document->slot;
+        GetDocumentTerms(*document, term_ids);
+        for (const TermId term_id : term_ids) {
+            --document_freqs_.Mutable(term_id);
+        }
+        removed_terms.insert(removed_terms.end(), term_ids.begin(), term_ids.end());
+        has_sealed_slots = has_sealed_slots || slot < first_mutable_slot_;
+        MarkSlotRemoved(slot);
+        EraseDocument(document_id);
+    }
+
+    std::sort(policy, removed_terms.begin(), removed_terms.end());
+    removed_terms.erase(std::unique(removed_terms.begin(), removed_terms.end()), removed_terms.end());
+    for (const TermId term_id : removed_terms) {
+        ReclaimTerm(term_id);
+    }
+
+    if (auto_merge_segments_ && has_sealed_slots) {
+        MergeSegments();
+    }
+}
+
+void SearchServer::SetPostingCompression(bool enabled) {
+    compress_postings_ = enabled;
+    for (size_t term_id = 0; term_id < postings_.Size(); ++term_id) {
+        postings_.Mutable(term_id).SetCompressed(enabled);
+    }
+    for (SealedSegment& segment : segments_) {
+        segment.index = std::make_shared<const IndexSegment>(segment.index->WithCompression(enabled));
+    }
+}
+
+void SearchServer::SetSegmentDocumentCount(size_t document_count) {
+    if (document_count == 0) {
+        throw std::invalid_argument("a segment must hold at least one document"s);
+    }
+    segment_document_count_ = document_count;
+    SealSegmentIfFull();
+}
+
+void SearchServer::SetAutoMergeSegments(bool enabled) {
+    auto_merge_segments_ = enabled;
+}
+
+void SearchServer::MergeSegments() {
+    while (const auto merge = PrepareSegmentMerge()) {
+        ApplySegmentMerge(*merge);
+    }
+}
+
+size_t SearchServer::GetSegmentCount() const {
+    return segments_.size();
+}
+
+std::optional<SearchServer::SegmentMerge> SearchServer::PrepareSegmentMerge() const {
+    const auto [first, last] = SelectSegmentsToMerge();
+    if (first == last) {
+        return std::nullopt;
+    }
+
+    SegmentMerge merge;
+    std::vector<TermId> term_ids;
+    for (size_t segment = first; segment < last; ++segment) {
+        merge.sources.push_back(segments_[segment].index);
+        segments_[segment].index->ForEachTerm([&term_ids](TermId term_id, const PostingList&) {
+            term_ids.push_back(term_id);
+        });
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+
+    // the sources are neighbours, so appending them one by one keeps every list in slot order
+    std::vector<TermId> merged_term_ids;
+    std::vector<PostingList> merged_postings;
+    for (const TermId term_id : term_ids) {
+        PostingList postings;
+        postings.SetCompressed(compress_postings_);
+        for (const auto& source : merge.sources) {
+            const PostingList* source_postings = source->FindPostings(term_id);
+            if (source_postings == nullptr) {
+                continue;
+            }
+            source_postings->ForEach([this, &postings](const Posting& posting) {
+                if (!IsRemoved(posting.slot)) {
+                    const int term_count = static_cast<int>(posting.term_freq * posting.document_length + 0.5);
+                    postings.Add(posting.slot, term_count, posting.document_length);
+                }
+            });
+        }
+        if (!postings.Empty()) {
+            merged_term_ids.push_back(term_id);
+            merged_postings.push_back(std::move(postings));
+        }
+    }
+
+    const int first_slot = merge.sources.front()->FirstSlot();
+    const int end_slot = merge.sources.back()->EndSlot();
+    merge.result = std::make_shared<const IndexSegment>(first_slot, end_slot, CountAliveDocuments(first_slot, end_slot),
+                                                        std::move(merged_term_ids), std::move(merged_postings));
+    return merge;
+}
+
+bool SearchServer::ApplySegmentMerge(const SegmentMerge& merge) {
+    const auto first = std::find_if(segments_.begin(), segments_.end(), [&merge](const SealedSegment& segment) {
+        return segment.index == merge.sources.front();
+    });
+    if (first == segments_.end() || static_cast<size_t>(segments_.end() - first) < merge.sources.size()
+        || !std::equal(merge.sources.begin(), merge.sources.end(), first,
+                       [](const auto& source, const SealedSegment& segment) { return source == segment.index; })) {
+        return false;
+    }
+
+    const auto last = first + merge.sources.size();
+    // documents removed after the merge was prepared are still in the result
+    const int alive_count = CountAliveDocuments(merge.result->FirstSlot(), merge.result->EndSlot());
+    if (alive_count == 0) {
+        segments_.erase(first, last);
+    } else {
+        *first = { merge.result, merge.result->DocumentCount() - alive_count };
+        segments_.erase(first + 1, last);
+    }
+    return true;
+}
+
+void SearchServer::Save(const std::string& path) const {
+    SnapshotWriter writer;
+
+    writer.BeginSection();
+    writer.WriteUint32(static_cast<uint32_t>(stop_words_->size()));
+    for (const std::string& stop_word : *stop_words_) {
+        writer.WriteString(stop_word);
+    }
+    writer.WriteUint32(compress_postings_ ? 1 : 0);
+
+    // released and unused words are not saved
+    std::vector<TermId> saved_terms;
+    for (size_t term_id = 0; term_id < terms_.Size(); ++term_id) {
+        if (document_freqs_[term_id] > 0) {
+            saved_terms.push_back(static_cast<TermId>(term_id));
+        }
+    }
+    writer.WriteUint32(static_cast<uint32_t>(saved_terms.size()));
+    for (const TermId term_id : saved_terms) {
+        writer.WriteString(terms_.GetWord(term_id));
+    }
+    writer.EndSection();
+
+    // removed documents leave holes in the slot table, the snapshot stores it compacted
+    std::vector<int> saved_slots(slots_.Size(), NO_DOCUMENT);
+    std::vector<SnapshotDocuments::Record> records;
+    std::vector<std::string_view> texts;
+    records.reserve(GetDocumentCount());
+    texts.reserve(GetDocumentCount());
+    uint64_t texts_size = 0;
+    for (size_t slot = 0; slot < slots_.Size(); ++slot) {
+        const DocumentSlot& document = slots_[slot];
+        if (document.document_id == NO_DOCUMENT) {
+            continue;
+        }
+        saved_slots[slot] = static_cast<int>(records.size());
+        texts.push_back(GetDocument(document.document_id).text);
+        records.push_back({ document.document_id, document.rating, static_cast<int32_t>(document.status),
+                            static_cast<uint32_t>(texts.back().size()), texts_size });
+        texts_size += texts.back().size();
+    }
+    std::vector<uint32_t> slots_by_id(records.size());
+    std::iota(slots_by_id.begin(), slots_by_id.end(), 0u);
+    std::sort(slots_by_id.begin(), slots_by_id.end(), [&records](uint32_t lhs, uint32_t rhs) {
+        return records[lhs].document_id < records[rhs].document_id;
+    });
+    writer.BeginSection();
+    writer.WriteUint32(static_cast<uint32_t>(records.size()));
+    writer.Align(alignof(SnapshotDocuments::Record));
+    writer.WriteBytes(records.data(), records.size() * sizeof(SnapshotDocuments::Record));
+    writer.WriteBytes(slots_by_id.data(), slots_by_id.size() * sizeof(uint32_t));
+    writer.WriteBytes(&texts_size, sizeof(texts_size));
+    writer.EndSection();
+    writer.BeginSection();
+    for (const std::string_view text : texts) {
+        writer.WriteBytes(text.data(), text.size());
+    }
+    writer.EndSection();
+
+    // the segments are stored merged into one, in the encoded blocks Load serves them from;
+    // the block tables of all words come first, then the encoded blocks in the same order
+    std::vector<uint8_t> block_data;
+    writer.BeginSection();
+    for (const TermId term_id : saved_terms) {
+        PostingList saved_postings;
+        saved_postings.SetCompressed(true);
+        for (size_t segment = 0; segment <= segments_.size(); ++segment) {
+            const PostingList* postings = FindPostings(segment, term_id);
+            if (postings == nullptr) {
+                continue;
+            }
+            postings->ForEach([&saved_slots, &saved_postings](const Posting& posting) {
+                const int slot = saved_slots[posting.slot];
+                if (slot != NO_DOCUMENT) {
+                    const int term_count = static_cast<int>(posting.term_freq * posting.document_length + 0.5);
+                    saved_postings.Add(slot, term_count, posting.document_length);
+                }
+            });
+        }
+        saved_postings.EncodeTail();
 
-        for (auto [key_string, value_double] : search_element) {
-            ids_to_document_freqs_[key_string].erase(document_id);
+        const double max_term_freq = saved_postings.MaxTermFreq();
+        writer.WriteUint32(static_cast<uint32_t>(saved_postings.Size()));
+        writer.WriteBytes(&max_term_freq, sizeof(max_term_freq));
+        writer.WriteUint32(static_cast<uint32_t>(saved_postings.GetBlockCount()));
+        writer.Align(alignof(PostingList::Block));
+        writer.WriteBytes(saved_postings.GetBlocks(), saved_postings.GetBlockCount() * sizeof(PostingList::Block));
+        writer.WriteUint32(static_cast<uint32_t>(saved_postings.GetBlockDataSize()));
+        block_data.insert(block_data.end(), saved_postings.GetBlockData(), saved_postings.GetBlockData() + saved_postings.GetBlockDataSize());
+    }
+    writer.EndSection();
+    writer.BeginSection();
+    writer.WriteBytes(block_data);
+    writer.EndSection();
+
+    writer.SaveToFile(path);
+}
+
+SearchServer SearchServer::Load(const std::string& path, SnapshotCheck check) {
+    const auto file = std::make_shared<const MappedFile>(path);
+    SnapshotReader reader(*file);
+    const auto corrupted = []() {
+        return std::runtime_error("index snapshot is corrupted"s);
+    };
+
+    reader.BeginSection(true);
+    std::vector<std::string_view> stop_words(reader.ReadUint32());
+    for (auto& stop_word : stop_words) {
+        stop_word = reader.ReadString();
+    }
+    SearchServer server(stop_words);
+    server.compress_postings_ = reader.ReadUint32() != 0;
+
+    const uint32_t term_count = reader.ReadUint32();
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        if (server.terms_.Intern(reader.ReadString()) != static_cast<TermId>(term_id)) {
+            throw corrupted();
         }
+    }
+    reader.EndSection();
+    server.ResizePostings();
 
-        ids_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+    server.snapshot_documents_ = std::make_shared<const SnapshotDocuments>(file, reader, check);
+    const SnapshotDocuments& documents = *server.snapshot_documents_;
+    const int document_count = static_cast<int>(documents.Size());
+    for (int slot = 0; slot < document_count; ++slot) {
+        const SnapshotDocuments::Record& record = documents.GetRecord(slot);
+        server.slots_.PushBack({ record.document_id, record.rating, static_cast<DocumentStatus>(record.status) });
     }
+    server.snapshot_document_count_ = document_count;
+    server.first_added_slot_ = document_count;
+    server.UpdateLogCounts();
+
+    // the block tables are checked against their checksum and to lie in order inside the
+    // encoded blocks, which are checked only with SnapshotCheck::FULL
+    struct LoadedPostings {
+        uint32_t posting_count;
+        double max_term_freq;
+        const PostingList::Block* blocks;
+        uint32_t block_count;
+        uint32_t block_data_size;
+    };
+    std::vector<LoadedPostings> loaded_postings(term_count);
+    reader.BeginSection(true);
+    for (LoadedPostings& loaded : loaded_postings) {
+        loaded.posting_count = reader.ReadUint32();
+        std::memcpy(&loaded.max_term_freq, reader.ReadBytes(sizeof(loaded.max_term_freq)), sizeof(loaded.max_term_freq));
+        loaded.block_count = reader.ReadUint32();
+        reader.Align(alignof(PostingList::Block));
+        loaded.blocks = reinterpret_cast<const PostingList::Block*>(reader.ReadBytes(loaded.block_count * sizeof(PostingList::Block)));
+        loaded.block_data_size = reader.ReadUint32();
+
+        size_t block_posting_count = 0;
+        uint32_t block_offset = 0;
+        int previous_slot = -1;
+        for (uint32_t i = 0; i < loaded.block_count; ++i) {
+            const PostingList::Block& block = loaded.blocks[i];
+            if (block.size == 0 || block.size > PostingList::BLOCK_SIZE || block.offset != block_offset
+                || block.byte_size > loaded.block_data_size - block_offset
+                || block.first_slot <= previous_slot || block.last_slot < block.first_slot || block.last_slot >= document_count) {
+                throw corrupted();
+            }
+            block_posting_count += block.size;
+            block_offset += block.byte_size;
+            previous_slot = block.last_slot;
+        }
+        if (loaded.posting_count == 0 || block_posting_count != loaded.posting_count || block_offset != loaded.block_data_size) {
+            throw corrupted();
+        }
+    }
+    reader.EndSection();
+
+    std::vector<TermId> term_ids;
+    std::vector<PostingList> postings;
+    term_ids.reserve(term_count);
+    postings.reserve(term_count);
+    reader.BeginSection(check == SnapshotCheck::FULL);
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        const LoadedPostings& loaded = loaded_postings[term_id];
+        const uint8_t* block_data = reader.ReadBytes(loaded.block_data_size);
+        server.document_freqs_.Mutable(term_id) = static_cast<int>(loaded.posting_count);
+        term_ids.push_back(static_cast<TermId>(term_id));
+        postings.push_back(PostingList::FromEncodedBlocks(loaded.blocks, loaded.block_count, block_data,
+                                                          loaded.posting_count, loaded.max_term_freq, file));
+    }
+    reader.EndSection();
+    if (!reader.AtEnd()) {
+        throw corrupted();
+    }
+
+    // the loaded documents form a single compact segment
+    if (document_count > 0) {
+        server.segments_.push_back({ std::make_shared<const IndexSegment>(0, document_count, document_count,
+                                                                          std::move(term_ids), std::move(postings)), 0 });
+    }
+    server.first_mutable_slot_ = document_count;
+    return server;
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_->count(word) > 0;
 }
 
 bool SearchServer::IsValidWord(std::string_view word) {
@@ -142,16 +854,216 @@ bool SearchServer::IsValidWord(std::string_view word) {
 }
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
+    // the words are split and checked for forbidden symbols in one pass
     std::vector<std::string_view> words;
-    for (const auto& word : SplitIntoWordsView(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("the word contains forbidden symbols"s);
+    if (!SplitIntoValidWordsView(text, words)) {
+        throw std::invalid_argument("there are forbidden symbols in the word"s);
+    }
+    words.erase(std::remove_if(words.begin(), words.end(), [this](std::string_view word) {
+        return IsStopWord(word);
+    }), words.end());
+    return words;
+}
+
+void SearchServer::ValidateNewDocumentId(int document_id) const {
+    if (document_id < 0) {
+        throw std::invalid_argument("id cannot be odd"s);
+    }
+    if (FindDocument(document_id)) {
+        throw std::invalid_argument("this id already exists"s);
+    }
+}
+
+std::optional<SearchServer::DocumentData> SearchServer::FindDocument(int document_id) const {
+    if (const int* slot = added_slots_.Find(document_id)) {
+        const DocumentSlot& document = slots_[*slot];
+        return DocumentData{ document.rating, document.status, added_documents_[*slot - first_added_slot_].text, *slot };
+    }
+    if (!snapshot_documents_) {
+        return std::nullopt;
+    }
+    const int slot = snapshot_documents_->FindSlot(document_id);
+    if (slot == NO_DOCUMENT || IsRemoved(slot)) {
+        return std::nullopt;
+    }
+    const DocumentSlot& document = slots_[slot];
+    return DocumentData{ document.rating, document.status, snapshot_documents_->GetText(slot), slot };
+}
+
+SearchServer::DocumentData SearchServer::GetDocument(int document_id) const {
+    const auto document = FindDocument(document_id);
+    if (!document) {
+        throw std::out_of_range("there is no document with id "s + std::to_string(document_id));
+    }
+    return *document;
+}
+
+std::map<std::string_view, double> SearchServer::ComputeWordFrequencies(std::string_view text) const {
+    const auto words = SplitIntoWordsNoStop(text);
+    std::map<std::string_view, double> word_freqs;
+    for (const std::string_view word : words) {
+        word_freqs[word] += 1.0;
+    }
+    // the same division as in AddDocument, so the frequencies are equal to the ones of the postings
+    for (auto& [word, term_freq] : word_freqs) {
+        term_freq /= words.size();
+    }
+    return word_freqs;
+}
+
+void SearchServer::GetDocumentTerms(const DocumentData& document, std::vector<TermId>& term_ids) const {
+    term_ids.clear();
+    if (document.slot >= first_added_slot_) {
+        for (const auto& [word, term_freq] : *added_documents_[document.slot - first_added_slot_].word_freqs) {
+            term_ids.push_back(terms_.Find(word));
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+        std::sort(term_ids.begin(), term_ids.end());
+        return;
+    }
+    for (const std::string_view word : SplitIntoWordsNoStop(document.text)) {
+        term_ids.push_back(terms_.Find(word));
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+}
+
+void SearchServer::EraseDocument(int document_id) {
+    if (const int* slot = added_slots_.Find(document_id)) {
+        added_documents_.Mutable(*slot - first_added_slot_).word_freqs.reset();
+        added_slots_.Erase(document_id);
+    } else {
+        --snapshot_document_count_;
+    }
+}
+
+void SearchServer::ReclaimTerm(TermId term_id) {
+    if (document_freqs_[term_id] > 0) {
+        return;
+    }
+    // the postings left of the word point only to removed slots; those of the in-memory
+    // segment are freed, the id may be taken by another word
+    if (!postings_[term_id].Empty()) {
+        PostingList& postings = postings_.Mutable(term_id);
+        postings = PostingList{};
+        postings.SetCompressed(compress_postings_);
+    }
+    terms_.Release(term_id);
+}
+
+void SearchServer::MarkSlotRemoved(int slot) {
+    slots_.Mutable(slot).document_id = NO_DOCUMENT;
+    generation_ = NextIndexGeneration();
+    if (slot < first_mutable_slot_) {
+        ++segments_[FindSegment(slot)].removed_count;
+    }
+}
+
+void SearchServer::ResizePostings() {
+    PostingList empty_postings;
+    empty_postings.SetCompressed(compress_postings_);
+    postings_.Resize(terms_.Size(), empty_postings);
+    document_freqs_.Resize(terms_.Size(), 0);
+}
+
+bool SearchServer::IsRemoved(int slot) const {
+    return slots_[slot].document_id == NO_DOCUMENT;
+}
+
+int SearchServer::CountAliveDocuments(int first_slot, int end_slot) const {
+    int alive_count = 0;
+    for (int slot = first_slot; slot < end_slot; ++slot) {
+        alive_count += IsRemoved(slot) ? 0 : 1;
+    }
+    return alive_count;
+}
+
+size_t SearchServer::FindSegment(int slot) const {
+    if (slot >= first_mutable_slot_) {
+        return segments_.size();
+    }
+    const auto it = std::upper_bound(segments_.begin(), segments_.end(), slot,
+        [](int slot, const SealedSegment& segment) { return slot < segment.index->FirstSlot(); });
+    return static_cast<size_t>(it - segments_.begin()) - 1;
+}
+
+const PostingList* SearchServer::FindPostings(size_t segment, TermId term_id) const {
+    if (segment == segments_.size()) {
+        return postings_[term_id].Empty() ? nullptr : &postings_[term_id];
+    }
+    return segments_[segment].index->FindPostings(term_id);
+}
+
+void SearchServer::SealSegmentIfFull() {
+    if (slots_.Size() - first_mutable_slot_ >= segment_document_count_) {
+        SealSegment();
+    }
+}
+
+void SearchServer::SealSegment() {
+    const int end_slot = static_cast<int>(slots_.Size());
+    const int document_count = CountAliveDocuments(first_mutable_slot_, end_slot);
+    // the documents removed from the segment left their postings, they are dropped once here
+    std::vector<int> removed_slots;
+    for (int slot = first_mutable_slot_; slot < end_slot && document_count > 0; ++slot) {
+        if (IsRemoved(slot)) {
+            removed_slots.push_back(slot);
         }
     }
-    return words;
+    std::vector<TermId> term_ids;
+    std::vector<PostingList> postings;
+    for (size_t term_id = 0; term_id < postings_.Size(); ++term_id) {
+        if (postings_[term_id].Empty()) {
+            continue;
+        }
+        PostingList& term_postings = postings_.Mutable(term_id);
+        term_postings.Remove(removed_slots.data(), removed_slots.data() + removed_slots.size());
+        if (document_count > 0 && !term_postings.Empty()) {
+            term_ids.push_back(static_cast<TermId>(term_id));
+            postings.push_back(std::move(term_postings));
+        }
+        term_postings = PostingList{};
+        term_postings.SetCompressed(compress_postings_);
+    }
+    if (document_count > 0) {
+        segments_.push_back({ std::make_shared<const IndexSegment>(first_mutable_slot_, end_slot, document_count,
+                                                                   std::move(term_ids), std::move(postings)), 0 });
+    }
+    first_mutable_slot_ = end_slot;
+
+    if (auto_merge_segments_) {
+        MergeSegments();
+    }
+}
+
+std::pair<size_t, size_t> SearchServer::SelectSegmentsToMerge() const {
+    const auto alive_count = [this](size_t segment) {
+        return segments_[segment].index->DocumentCount() - segments_[segment].removed_count;
+    };
+
+    for (size_t segment = 0; segment < segments_.size(); ++segment) {
+        if (segments_[segment].removed_count * 2 > segments_[segment].index->DocumentCount()) {
+            return { segment, segment + 1 };
+        }
+    }
+
+    // among the runs of similar size the smallest one is the cheapest to merge
+    std::pair<size_t, size_t> result{ 0, 0 };
+    long long best_size = 0;
+    for (size_t first = 0; first + SEGMENT_MERGE_FACTOR <= segments_.size(); ++first) {
+        long long smallest = alive_count(first);
+        long long largest = smallest;
+        long long size = 0;
+        for (size_t segment = first; segment < first + SEGMENT_MERGE_FACTOR; ++segment) {
+            smallest = std::min<long long>(smallest, alive_count(segment));
+            largest = std::max<long long>(largest, alive_count(segment));
+            size += alive_count(segment);
+        }
+        if (largest <= smallest * static_cast<long long>(SEGMENT_MERGE_FACTOR) && (result.first == result.second || size < best_size)) {
+            result = { first, first + SEGMENT_MERGE_FACTOR };
+            best_size = size;
+        }
+    }
+    return result;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -165,6 +1077,25 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+uint64_t SearchServer::NextIndexGeneration() {
+    static std::atomic<uint64_t> next_generation{ 0 };
+    return next_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string SearchServer::MakeResultCacheKey(const Query& query, DocumentStatus status, size_t max_document_count) {
+    // words never contain spaces and a plus word never starts with a minus
+    std::string key = std::to_string(static_cast<int>(status)) + ':' + std::to_string(max_document_count);
+    for (const std::string_view word : query.plus_words) {
+        key += ' ';
+        key += word;
+    }
+    for (const std::string_view word : query.minus_words) {
+        key += " -"s;
+        key += word;
+    }
+    return key;
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
     QueryWord result;
 
@@ -185,8 +1116,17 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
     Query result;
+    std::vector<std::string_view> words;
+    ParseQuery(text, words, result);
+    return result;
+}
 
-    for (auto word : SplitIntoWordsView(text)) {
+void SearchServer::ParseQuery(std::string_view text, std::vector<std::string_view>& words, Query& result) const {
+    result.plus_words.clear();
+    result.minus_words.clear();
+
+    SplitIntoWordsView(text, words);
+    for (auto word : words) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -209,8 +1149,6 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
 
     newSize = last_plus - result.plus_words.begin();
     result.plus_words.resize(newSize);
-
-    return result;
 }
 
 SearchServer::Query SearchServer::ParseQueryParallel(std::string_view text) const {
@@ -230,6 +1168,96 @@ SearchServer::Query SearchServer::ParseQueryParallel(std::string_view text) cons
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word ) const {
-    return std::log( GetDocumentCount() * 1.0 / ids_to_document_freqs_.at( word ).size() );
-}
\ No newline at end of file
+void SearchServer::ResolvePlusWords(const Query& query, std::vector<QueryTerm>& terms) const {
+    terms.clear();
+    for (const std::string_view word : query.plus_words) {
+        const TermId term_id = terms_.Find(word);
+        if (term_id != TermDictionary::NO_TERM && document_freqs_[term_id] > 0) {
+            terms.push_back({ term_id, ComputeWordInverseDocumentFreq(document_freqs_[term_id]) });
+        }
+    }
+}
+
+void SearchServer::ResolveSegmentTerms(size_t segment, const std::vector<QueryTerm>& terms, std::vector<SegmentTerm>& segment_terms) const {
+    segment_terms.clear();
+    for (const auto [term_id, inverse_document_freq] : terms) {
+        if (const PostingList* postings = FindPostings(segment, term_id)) {
+            segment_terms.push_back({ postings, inverse_document_freq });
+        }
+    }
+}
+
+bool SearchServer::ContainsWord(int slot, std::string_view word) const {
+    const TermId term_id = terms_.Find(word);
+    if (term_id == TermDictionary::NO_TERM) {
+        return false;
+    }
+    const PostingList* postings = FindPostings(FindSegment(slot), term_id);
+    return postings != nullptr && postings->Contains(slot);
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(int document_freq) const {
+    return log_counts_[GetDocumentCount()] - log_counts_[document_freq];
+}
+
+void SearchServer::UpdateLogCounts() {
+    const size_t document_count = static_cast<size_t>(GetDocumentCount());
+    while (log_counts_.Size() <= document_count) {
+        log_counts_.PushBack(std::log(static_cast<double>(log_counts_.Size())));
+    }
+}
+
+size_t SearchServer::CountParallelRanges() const {
+    const size_t max_range_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    return std::clamp<size_t>(slots_.Size() / PARALLEL_RANGE_MIN_SLOTS, 1, max_range_count);
+}
+
+QueryExplanation::Term SearchServer::ExplainQueryWord(std::string_view word, bool is_minus) const {
+    QueryExplanation::Term term;
+    term.word = std::string(word);
+    const TermId term_id = terms_.Find(word);
+    if (term_id == TermDictionary::NO_TERM) {
+        return term;
+    }
+    for (size_t segment = 0; segment <= segments_.size(); ++segment) {
+        if (const PostingList* postings = FindPostings(segment, term_id)) {
+            term.posting_count += postings->Size();
+        }
+    }
+    term.document_freq = document_freqs_[term_id];
+    if (!is_minus && term.document_freq > 0) {
+        term.inverse_document_freq = ComputeWordInverseDocumentFreq(term.document_freq);
+    }
+    return term;
+}
+
+SearchServer::ScoringBuffers& SearchServer::GetThreadScoringBuffers() {
+    thread_local ScoringBuffers buffers;
+    return buffers;
+}
+
+PostingList::Cursor& SearchServer::ScoringBuffers::AcquireCursor(size_t index, const PostingList& postings) {
+    if (index < cursors.size()) {
+        cursors[index].Reset(postings);
+    } else {
+        cursors.emplace_back(postings);
+    }
+    return cursors[index];
+}
+
+void SearchServer::ResolveMinusWords(const Query& query, std::vector<TermId>& terms) const {
+    terms.clear();
+    for (const std::string_view word : query.minus_words) {
+        const TermId term_id = terms_.Find(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            terms.push_back(term_id);
+        }
+    }
+}
+
+std::pair<int, int> SearchServer::GetSegmentSlots(size_t segment) const {
+    if (segment == segments_.size()) {
+        return { first_mutable_slot_, static_cast<int>(slots_.Size()) };
+    }
+    return { segments_[segment].index->FirstSlot(), segments_[segment].index->EndSlot() };
+}
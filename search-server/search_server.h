@@ -4,6 +4,19 @@
 #include "string_processing.h"
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+#include "index_segment.h"
+#include "query_control.h"
+#include "query_result_cache.h"
+#include "text_arena.h"
+#include "search_metrics.h"
+#include "query_explanation.h"
+#include "snapshot_documents.h"
+#include "chunked_vector.h"
+#include "persistent_id_map.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -11,16 +24,31 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cmath>
+#include <atomic>
 #include <execution>
+#include <future>
+#include <functional>
+#include <type_traits>
 #include <string_view>
+#include <memory>
+#include <optional>
+#include <numeric>
+#include <thread>
+#include <iterator>
+#include <set>
 
 using namespace std::string_literals;
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPSILON = 1e-6;
+template <typename ExecutionPolicy>
+using EnableIfExecutionPolicy = std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, int>;
 
 class SearchServer {
 public:
+    static constexpr size_t DEFAULT_SEGMENT_DOCUMENT_COUNT = 4096;
+    static constexpr size_t SEGMENT_MERGE_FACTOR = 4;
+    // smaller indexes are not split between threads in the par query path
+    static constexpr size_t PARALLEL_RANGE_MIN_SLOTS = 16384;
+
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
 
@@ -36,47 +64,216 @@ public:
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    // Adds a batch at once: documents are tokenized concurrently and their postings are
+    // merged into the index term by term. Nothing is added if any document is invalid.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy& policy, const std::vector<NewDocument>& documents);
+
+    // The same, but an invalid document is left out and passed to reject with its index in
+    // documents and the reason, the valid ones are added
+    using RejectDocument = std::function<void(size_t index, const std::string& reason)>;
+    void AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<NewDocument>& documents,
+                      const RejectDocument& reject);
+    void AddDocuments(const std::execution::parallel_policy& policy, const std::vector<NewDocument>& documents,
+                      const RejectDocument& reject);
+
+    // max_document_count limits the result size, pass a larger value to fetch several pages at once
+    template <typename DocumentPredicate, typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = 0>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
-
-    template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = 0>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
     
-    template <typename ExecutionPolicy>
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = 0>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // Runs until the query is done or control stops it. A stopped query returns the best
+    // of the documents scored so far and leaves control.IsStopped() set.
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const QueryControl& control, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const QueryControl& control, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // The same on a separate thread. The server must outlive the future and must not be
+    // changed until it is ready.
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> FindTopDocumentsAsync(QueryControl control, std::string raw_query, DocumentPredicate document_predicate,
+                                                             size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::future<std::vector<Document>> FindTopDocumentsAsync(QueryControl control, std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    class QueryContext;
+
+    // The same with the buffers of context, the result is kept in it until its next query.
+    // Queries through a context skip the result cache.
+    template <typename DocumentPredicate>
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                  size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                  size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // FindTopDocuments that also reports how the query ran: its words with their postings and IDF,
+    // the phase times, the documents scored and excluded and the execution path. It skips the
+    // result cache and is timed even with the metrics off.
+    template <typename DocumentPredicate, typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = 0>
+    QueryExplanation ExplainTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                         size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = 0>
+    QueryExplanation ExplainTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                         size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    QueryExplanation ExplainTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                         size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Keeps the results of the queries by status, repeated queries then skip the scoring.
+    // Copies of the server share the cache, nullptr turns it off.
+    void SetResultCache(std::shared_ptr<QueryResultCache> cache);
+    const std::shared_ptr<QueryResultCache>& GetResultCache() const;
+
     int GetDocumentCount() const;
 
-    const std::set<int>::const_iterator begin() const noexcept;
-    const std::set<int>::const_iterator end() const noexcept;
+    class DocumentIdIterator;
+
+    // the ids of the documents in increasing order
+    DocumentIdIterator begin() const noexcept;
+    DocumentIdIterator end() const noexcept;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const;
-
+    // A stopped match returns the plus words found so far. The minus words are checked first,
+    // so a match stopped among them returns none, which only control.IsStopped() tells apart
+    // from a document excluded by a minus word.
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const QueryControl& control, std::string_view raw_query, int document_id) const;
+    // the matched words point into the index instead of the query
+    std::future<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocumentAsync(QueryControl control, std::string raw_query, int document_id) const;
+    // the matched words are kept in context until its next query
+    std::tuple<const std::vector<std::string_view>&, DocumentStatus> MatchDocument(QueryContext& context, std::string_view raw_query, int document_id) const;
+
+    // the map of a loaded document is built on first use and kept with the snapshot
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // The distinct terms of the document in increasing order, none for an unknown id. Equal
+    // word sets give equal terms in one state of the server. Nothing is kept for a loaded document.
+    void GetDocumentTerms(int document_id, std::vector<TermId>& term_ids) const;
 
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
     void RemoveDocument(int document_id);
 
+    // Removes a batch with one pass over every affected posting list. Unknown ids are skipped.
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::sequenced_policy& policy, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::parallel_policy& policy, const std::vector<int>& document_ids);
+
+    // Stores posting lists as delta-coded StreamVByte blocks, which takes several
+    // times less memory at the cost of decoding them on every query.
+    void SetPostingCompression(bool enabled);
+
+    // New documents are indexed into a small in-memory segment, which is sealed into an
+    // immutable segment once it holds document_count documents. Queries visit all segments.
+    void SetSegmentDocumentCount(size_t document_count);
+
+    // Sealed segments are consolidated by a tiered policy: a run of SEGMENT_MERGE_FACTOR
+    // neighbours of similar size is merged into one, and so is a segment where most of the
+    // documents are removed. By default this happens right after a segment is sealed;
+    // with auto merging off the owner merges, e.g. in the background through
+    // PrepareSegmentMerge on a snapshot and ApplySegmentMerge on the next version.
+    void SetAutoMergeSegments(bool enabled);
+    void MergeSegments();
+    size_t GetSegmentCount() const;
+
+    struct SegmentMerge {
+        std::vector<std::shared_ptr<const IndexSegment>> sources;
+        std::shared_ptr<const IndexSegment> result;
+    };
+
+    std::optional<SegmentMerge> PrepareSegmentMerge() const;
+    // returns false if the merged segments are no longer part of the index
+    bool ApplySegmentMerge(const SegmentMerge& merge);
+
+    // Writes the whole index into a single versioned file. Load maps the file and serves the
+    // loaded documents from it in place: their postings stay in the encoded blocks of the file,
+    // compressed whatever SetPostingCompression says until it is called again, and their word
+    // frequencies are built from the texts on first use. The server keeps the mapping alive.
+    // By default Load checks only the tables it parses, so the texts and the encoded postings
+    // are read from disk when first used and damage in them is not detected: a damaged text
+    // yields wrong words, a damaged block wrong or out of range postings. Files that may be
+    // damaged are loaded with SnapshotCheck::FULL, which reads and checks the whole file.
+    void Save(const std::string& path) const;
+    static SearchServer Load(const std::string& path, SnapshotCheck check = SnapshotCheck::TABLES);
+
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
-        std::string text_;
+        // points into texts_ or into the mapped snapshot
+        std::string_view text;
+        int slot;
+    };
+
+    struct AddedDocument {
+        std::string_view text;
+        std::shared_ptr<const std::map<std::string_view, double>> word_freqs;
+    };
+
+    // dense per-document record addressed by the slot stored in postings
+    struct DocumentSlot {
+        int document_id;
+        int rating;
+        DocumentStatus status;
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> ids_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> ids_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    static constexpr int NO_DOCUMENT = -1;
+
+    struct SealedSegment {
+        std::shared_ptr<const IndexSegment> index;
+        int removed_count;
+    };
+
+    // Copies of the server share everything but the in-memory segment: the tables below are
+    // chunked or persistent, and a change copies only the chunks and the nodes it touches.
+    // VersionedSearchServer copies the server for every update.
+    std::shared_ptr<const std::set<std::string, std::less<>>> stop_words_;
+    TermDictionary terms_;
+    // number of alive documents containing the term
+    ChunkedVector<int, 8> document_freqs_;
+    // log_counts_[k] is log(k) up to the largest document count so far, so an IDF is
+    // the difference of two lookups and no logarithm is taken while querying
+    ChunkedVector<double, 10> log_counts_;
+    // the in-memory segment, it holds the documents from first_mutable_slot_ on
+    ChunkedVector<PostingList, 4> postings_;
+    int first_mutable_slot_ = 0;
+    // sealed segments in slot order
+    std::vector<SealedSegment> segments_;
+    size_t segment_document_count_ = DEFAULT_SEGMENT_DOCUMENT_COUNT;
+    bool auto_merge_segments_ = true;
+    bool compress_postings_ = false;
+    // the documents added since the server was created or loaded, they take the slots from
+    // first_added_slot_ on; a removed one keeps its text only
+    PersistentIdMap<int> added_slots_;
+    ChunkedVector<AddedDocument, 8> added_documents_;
+    int first_added_slot_ = 0;
+    TextArena texts_;
+    // the loaded documents, they keep the first slots; the removed ones lose their slot only
+    std::shared_ptr<const SnapshotDocuments> snapshot_documents_;
+    int snapshot_document_count_ = 0;
+    ChunkedVector<DocumentSlot, 10> slots_;
+    std::shared_ptr<QueryResultCache> result_cache_;
+    // changes with every added or removed document and is unique among all servers,
+    // so copies sharing a result cache never mix their results
+    uint64_t generation_ = NextIndexGeneration();
+
+    static uint64_t NextIndexGeneration();
 
     bool IsStopWord(std::string_view word) const;
 
@@ -86,6 +283,40 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    void ValidateNewDocumentId(int document_id) const;
+    void ResizePostings();
+
+    std::optional<DocumentData> FindDocument(int document_id) const;
+    // throws std::out_of_range for an unknown id
+    DocumentData GetDocument(int document_id) const;
+    std::map<std::string_view, double> ComputeWordFrequencies(std::string_view text) const;
+    // a loaded document is tokenized again, not cached, so removing loaded documents
+    // leaves nothing behind in the shared snapshot
+    void GetDocumentTerms(const DocumentData& document, std::vector<TermId>& term_ids) const;
+    // forgets the document once its postings are handled
+    void EraseDocument(int document_id);
+
+    bool IsRemoved(int slot) const;
+    int CountAliveDocuments(int first_slot, int end_slot) const;
+
+    // index in segments_, or segments_.size() for the in-memory segment
+    size_t FindSegment(int slot) const;
+    const PostingList* FindPostings(size_t segment, TermId term_id) const;
+
+    void SealSegmentIfFull();
+    void SealSegment();
+    std::pair<size_t, size_t> SelectSegmentsToMerge() const;
+
+    template <typename ExecutionPolicy>
+    // throws for an invalid document unless reject is given
+    void AddDocumentBatch(ExecutionPolicy&& policy, const std::vector<NewDocument>& documents, const RejectDocument* reject);
+    template <typename ExecutionPolicy>
+    void RemoveDocumentBatch(ExecutionPolicy&& policy, const std::vector<int>& document_ids);
+
+    // frees an emptied in-memory posting list, and the word itself once no document has it
+    void ReclaimTerm(TermId term_id);
+    void MarkSlotRemoved(int slot);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus = false;
@@ -100,201 +331,577 @@ private:
     };
 
     Query ParseQuery(std::string_view text) const;
+    // the same into reused buffers, words receives the tokens
+    void ParseQuery(std::string_view text, std::vector<std::string_view>& words, Query& result) const;
     Query ParseQueryParallel(std::string_view text) const;
+    static std::string MakeResultCacheKey(const Query& query, DocumentStatus status, size_t max_document_count);
 
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    struct QueryTerm {
+        TermId term_id;
+        double inverse_document_freq;
+    };
+
+    struct SegmentTerm {
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+
+    void ResolvePlusWords(const Query& query, std::vector<QueryTerm>& terms) const;
+    // keeps the query order, the relevance is summed in it
+    void ResolveSegmentTerms(size_t segment, const std::vector<QueryTerm>& terms, std::vector<SegmentTerm>& segment_terms) const;
 
+    struct TermCursor {
+        PostingList::Cursor* cursor;
+        double upper_bound;
+        size_t term_index;
+    };
+
+    // scratch of FindDocumentsInRange, kept by every thread and by every QueryContext
+    struct ScoringBuffers {
+        ScoreAccumulator accumulator;
+        std::vector<SegmentTerm> segment_terms;
+        std::vector<PostingList::Cursor> cursors;
+        std::vector<TermCursor> term_cursors;
+        std::vector<double> bound_prefix;
+        std::vector<double> matched_term_freqs;
+        std::vector<char> is_matched;
+
+        // the cursor at index of the pool, moved to the start of postings
+        PostingList::Cursor& AcquireCursor(size_t index, const PostingList& postings);
+    };
+
+    // checks the control once per posting block, reading the clock for every posting costs too much
+    class StopCheck {
+    public:
+        explicit StopCheck(const QueryControl* control)
+            : control_(control)
+        {
+        }
+
+        bool operator()() {
+            if (!is_stopped_ && control_ != nullptr && ++step_count_ % PostingList::BLOCK_SIZE == 0) {
+                is_stopped_ = control_->ShouldStop();
+            }
+            return is_stopped_;
+        }
+
+        bool IsStopped() const noexcept {
+            return is_stopped_;
+        }
+
+    private:
+        const QueryControl* control_;
+        size_t step_count_ = 0;
+        bool is_stopped_ = false;
+    };
+
+    // control is null for a query without limits, stats is null while the metrics are off
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, DocumentPredicate document_predicate,
+                          TopDocuments& top_documents, const QueryControl* control, QueryStats* stats) const;
     
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate,
+                          TopDocuments& top_documents, const QueryControl* control, QueryStats* stats) const;
+
+    // scores the documents in the slots [first_slot, end_slot), the seq and par paths share it;
+    // stats belong to the range, the par path merges them
+    template<typename DocumentPredicate>
+    void FindDocumentsInRange(const std::vector<QueryTerm>& plus_terms, const std::vector<TermId>& minus_terms,
+                              DocumentPredicate document_predicate, int first_slot, int end_slot,
+                              TopDocuments& top_documents, const QueryControl* control, QueryStats* stats,
+                              ScoringBuffers& buffers) const;
+
+    template<typename DocumentPredicate>
+    void FindTopDocumentsWithPruning(const std::vector<SegmentTerm>& terms, ScoringBuffers& buffers,
+                                     DocumentPredicate document_predicate, int first_slot, int end_slot,
+                                     TopDocuments& top_documents, StopCheck& should_stop, QueryStats& range_stats) const;
+
+    bool ContainsWord(int slot, std::string_view word) const;
+
+    double ComputeWordInverseDocumentFreq(int document_freq) const;
+    void UpdateLogCounts();
+
+    static ScoringBuffers& GetThreadScoringBuffers();
+
+    void ResolveMinusWords(const Query& query, std::vector<TermId>& terms) const;
+    std::pair<int, int> GetSegmentSlots(size_t segment) const;
+
+    // the number of slot ranges the par query path scores separately
+    size_t CountParallelRanges() const;
+    QueryExplanation::Term ExplainQueryWord(std::string_view word, bool is_minus) const;
+};
+
+class SearchServer::DocumentIdIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int*;
+    using reference = const int&;
+
+    reference operator*() const noexcept {
+        return document_id_;
+    }
 
-    double ComputeWordInverseDocumentFreq(std::string_view word ) const;
+    DocumentIdIterator& operator++() noexcept;
+    DocumentIdIterator operator++(int) noexcept;
+
+    bool operator==(const DocumentIdIterator& other) const noexcept {
+        return added_ == other.added_ && loaded_rank_ == other.loaded_rank_;
+    }
+
+    bool operator!=(const DocumentIdIterator& other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    friend class SearchServer;
+
+    // the added and the loaded documents are merged by id
+    const SearchServer* server_;
+    PersistentIdMap<int>::Iterator added_;
+    size_t loaded_rank_;
+    int document_id_ = 0;
+
+    DocumentIdIterator(const SearchServer* server, PersistentIdMap<int>::Iterator added, size_t loaded_rank) noexcept;
+
+    size_t GetLoadedCount() const noexcept;
+    int GetLoadedId() const noexcept;
+    void SkipRemovedLoaded() noexcept;
+    void UpdateDocumentId() noexcept;
+};
+
+// Buffers of the queries run through the context. Once they have grown to the size of
+// the queries, FindTopDocuments and MatchDocument with a context allocate nothing.
+// A context serves one query at a time.
+class SearchServer::QueryContext {
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> words_;
+    Query query_;
+    std::vector<QueryTerm> plus_terms_;
+    std::vector<TermId> minus_terms_;
+    ScoringBuffers scoring_;
+    TopDocuments top_documents_{ 0 };
+    std::vector<Document> documents_;
+    std::vector<std::string_view> matched_words_;
 };
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    : stop_words_(std::make_shared<const std::set<std::string, std::less<>>>(MakeUniqueNonEmptyStrings(stop_words)))
 {
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    if (!all_of(stop_words_->begin(), stop_words_->end(), IsValidWord)) {
         throw std::invalid_argument("the word contains forbidden symbols"s);
     }
 }
 
-template <typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    auto matched_documents = FindAllDocuments(policy, raw_query, document_predicate);
-
-    std::sort(policy,
-        matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename DocumentPredicate, typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_document_count) const {
+    QueryRecorder recorder(QueryCounter::SEARCHES);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
+    const auto query = ParseQuery(raw_query);
+    parse_timer.Stop();
+    if (max_document_count == 0) {
+        return {};
     }
-
-    return matched_documents;
+    TopDocuments top_documents(max_document_count);
+    FindAllDocuments(policy, query, document_predicate, top_documents, nullptr, recorder.GetStats());
+    PhaseTimer top_timer(recorder.GetStats(), QueryPhase::TOP_K);
+    return std::move(top_documents).Build();
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_document_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_document_count);
 }
 
-template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                                     size_t max_document_count) const {
+    QueryRecorder recorder(QueryCounter::SEARCHES);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
+    const auto query = ParseQuery(raw_query);
+    parse_timer.Stop();
+    if (max_document_count == 0) {
+        return {};
+    }
+    std::string cache_key;
+    if (result_cache_) {
+        cache_key = MakeResultCacheKey(query, status, max_document_count);
+        if (auto documents = result_cache_->Find(cache_key, generation_)) {
+            return std::move(*documents);
+        }
+    }
+
+    TopDocuments top_documents(max_document_count);
+    FindAllDocuments(policy, query,
         [&status](int document_id, DocumentStatus new_status, int rating) {
             return new_status == status;
-    });
+        }, top_documents, nullptr, recorder.GetStats());
+    PhaseTimer top_timer(recorder.GetStats(), QueryPhase::TOP_K);
+    auto documents = std::move(top_documents).Build();
+    top_timer.Stop();
+    if (result_cache_) {
+        result_cache_->Insert(std::move(cache_key), generation_, documents);
+    }
+    return documents;
 }
 
-template <typename ExecutionPolicy>
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const QueryControl& control, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_document_count) const {
+    QueryRecorder recorder(QueryCounter::SEARCHES);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
     const auto query = ParseQuery(raw_query);
-    std::map<int, double> document_to_relevance;
-
-    for (auto word : query.plus_words) {
-        if (ids_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (auto [document_id, term_freq] : ids_to_document_freqs_.at(word)) {
-            const DocumentData& documents_data = documents_.at(document_id);
-            if (document_predicate(document_id, documents_data.status, documents_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
-        }
+    parse_timer.Stop();
+    if (max_document_count == 0) {
+        return {};
     }
-    
-    for (auto word : query.minus_words) {
-        if (ids_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto& [document_id, term_freq] : ids_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
+    TopDocuments top_documents(max_document_count);
+    FindAllDocuments(std::execution::seq, query, document_predicate, top_documents, &control, recorder.GetStats());
+    PhaseTimer top_timer(recorder.GetStats(), QueryPhase::TOP_K);
+    return std::move(top_documents).Build();
+}
+
+template <typename DocumentPredicate>
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                            size_t max_document_count) const {
+    QueryRecorder recorder(QueryCounter::SEARCHES);
+    PhaseTimer parse_timer(recorder.GetStats(), QueryPhase::PARSE);
+    ParseQuery(raw_query, context.words_, context.query_);
+    context.documents_.clear();
+    if (max_document_count == 0) {
+        return context.documents_;
     }
+    ResolvePlusWords(context.query_, context.plus_terms_);
+    ResolveMinusWords(context.query_, context.minus_terms_);
+    parse_timer.Stop();
+    context.top_documents_.Reset(max_document_count);
+    FindDocumentsInRange(context.plus_terms_, context.minus_terms_, document_predicate,
+                         0, static_cast<int>(slots_.Size()), context.top_documents_, nullptr, recorder.GetStats(), context.scoring_);
+    PhaseTimer top_timer(recorder.GetStats(), QueryPhase::TOP_K);
+    context.top_documents_.Build(context.documents_);
+    return context.documents_;
+}
 
-    std::vector<Document> matched_documents;
-    for (auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template <typename DocumentPredicate>
+std::future<std::vector<Document>> SearchServer::FindTopDocumentsAsync(QueryControl control, std::string raw_query, DocumentPredicate document_predicate,
+                                                                       size_t max_document_count) const {
+    return std::async(std::launch::async,
+        [this, control = std::move(control), raw_query = std::move(raw_query), document_predicate, max_document_count]() {
+            return FindTopDocuments(control, raw_query, document_predicate, max_document_count);
+        });
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+QueryExplanation SearchServer::ExplainTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                   size_t max_document_count) const {
+    const auto start_time = QueryStats::Clock::now();
+    QueryExplanation explanation;
+    PhaseTimer parse_timer(&explanation.stats, QueryPhase::PARSE);
+    const auto query = ParseQuery(raw_query);
+    parse_timer.Stop();
+
+    // looked up apart from the query, so the lookups are not counted in its phases
+    for (const std::string_view word : query.plus_words) {
+        explanation.plus_terms.push_back(ExplainQueryWord(word, false));
+    }
+    for (const std::string_view word : query.minus_words) {
+        explanation.minus_terms.push_back(ExplainQueryWord(word, true));
+    }
+    explanation.is_parallel = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>;
+    explanation.range_count = explanation.is_parallel ? CountParallelRanges() : 1;
+
+    if (max_document_count > 0) {
+        TopDocuments top_documents(max_document_count);
+        FindAllDocuments(policy, query, document_predicate, top_documents, nullptr, &explanation.stats);
+        PhaseTimer top_timer(&explanation.stats, QueryPhase::TOP_K);
+        explanation.documents = std::move(top_documents).Build();
     }
-    return matched_documents;
+    explanation.total_nanoseconds = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(QueryStats::Clock::now() - start_time).count());
+    if (MetricsRegistry::Instance().IsEnabled()) {
+        MetricsRegistry::Instance().RecordQuery(QueryCounter::SEARCHES, explanation.stats);
+    }
+    return explanation;
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+QueryExplanation SearchServer::ExplainTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                                                   size_t max_document_count) const {
+    return ExplainTopDocuments(policy, raw_query,
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, max_document_count);
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    const auto query = ParseQuery(raw_query);
+void SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, DocumentPredicate document_predicate,
+                                    TopDocuments& top_documents, const QueryControl* control, QueryStats* stats) const {
+    PhaseTimer parse_timer(stats, QueryPhase::PARSE);
+    std::vector<QueryTerm> plus_terms;
+    std::vector<TermId> minus_terms;
+    ResolvePlusWords(query, plus_terms);
+    ResolveMinusWords(query, minus_terms);
+    parse_timer.Stop();
+    FindDocumentsInRange(plus_terms, minus_terms, document_predicate,
+                         0, static_cast<int>(slots_.Size()), top_documents, control, stats, GetThreadScoringBuffers());
+}
 
-    for (auto word : query.plus_words) {
-        if (ids_to_document_freqs_.count(word) == 0) {
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate,
+                                    TopDocuments& top_documents, const QueryControl* control, QueryStats* stats) const {
+    PhaseTimer parse_timer(stats, QueryPhase::PARSE);
+    std::vector<QueryTerm> plus_terms;
+    std::vector<TermId> minus_terms;
+    ResolvePlusWords(query, plus_terms);
+    ResolveMinusWords(query, minus_terms);
+    parse_timer.Stop();
+
+    // the slots are split into ranges scored independently, each with its own accumulator and top,
+    // so even a single long posting list is shared between the threads
+    const size_t slot_count = slots_.Size();
+    const size_t range_count = CountParallelRanges();
+    std::vector<TopDocuments> range_tops(range_count, TopDocuments(top_documents.MaxCount()));
+    std::vector<QueryStats> range_stats(stats != nullptr ? range_count : 0);
+    std::vector<size_t> range_indexes(range_count);
+    std::iota(range_indexes.begin(), range_indexes.end(), size_t{ 0 });
+
+    std::for_each(policy, range_indexes.begin(), range_indexes.end(),
+        [&](size_t range) {
+            const int first_slot = static_cast<int>(slot_count * range / range_count);
+            const int end_slot = static_cast<int>(slot_count * (range + 1) / range_count);
+            FindDocumentsInRange(plus_terms, minus_terms, document_predicate, first_slot, end_slot, range_tops[range], control,
+                                 stats != nullptr ? &range_stats[range] : nullptr, GetThreadScoringBuffers());
+        });
+
+    // the phases of the ranges are summed, so they are thread time rather than wall time
+    for (const QueryStats& stats_of_range : range_stats) {
+        stats->Merge(stats_of_range);
+    }
+    PhaseTimer top_timer(stats, QueryPhase::TOP_K);
+    for (TopDocuments& range_top : range_tops) {
+        for (const Document& document : std::move(range_top).Build()) {
+            top_documents.Add(document);
+        }
+    }
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindDocumentsInRange(const std::vector<QueryTerm>& plus_terms, const std::vector<TermId>& minus_terms,
+                                        DocumentPredicate document_predicate, int first_slot, int end_slot,
+                                        TopDocuments& top_documents, const QueryControl* control, QueryStats* stats,
+                                        ScoringBuffers& buffers) const {
+    ScoreAccumulator& accumulator = buffers.accumulator;
+    accumulator.Reset(slots_.Size());
+    StopCheck should_stop(control);
+    // counted even without stats, an increment costs less than checking for them
+    QueryStats range_stats;
+    QueryStats* const timed_stats = stats != nullptr ? &range_stats : nullptr;
+
+    // every document lives in one segment, so the segments are scored independently into one top
+    std::vector<SegmentTerm>& segment_terms = buffers.segment_terms;
+    for (size_t segment = 0; segment <= segments_.size() && !should_stop.IsStopped(); ++segment) {
+        const auto [segment_first_slot, segment_end_slot] = GetSegmentSlots(segment);
+        if (segment_end_slot <= first_slot || segment_first_slot >= end_slot) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : ids_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+
+        PhaseTimer traversal_timer(timed_stats, QueryPhase::POSTING_TRAVERSAL);
+        for (const TermId term_id : minus_terms) {
+            if (const PostingList* postings = FindPostings(segment, term_id)) {
+                PostingList::Cursor& cursor = buffers.AcquireCursor(0, *postings);
+                for (cursor.SkipTo(first_slot); cursor.Slot() < end_slot && !should_stop(); cursor.Next()) {
+                    accumulator.Exclude(cursor.Slot());
+                    ++range_stats.postings_scanned;
+                }
             }
         }
-    }
+        traversal_timer.Stop();
+        // without all the minus marks the segment cannot be scored
+        if (should_stop.IsStopped()) {
+            break;
+        }
 
-    for (auto word : query.minus_words) {
-        if (ids_to_document_freqs_.count(word) == 0) {
+        PhaseTimer scoring_timer(timed_stats, QueryPhase::SCORING);
+        ResolveSegmentTerms(segment, plus_terms, segment_terms);
+        if (segment_terms.size() > 1) {
+            FindTopDocumentsWithPruning(segment_terms, buffers, document_predicate, first_slot, end_slot, top_documents, should_stop,
+                                        range_stats);
             continue;
         }
-        for (const auto [document_id, _] : ids_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+
+        for (const auto [postings, inverse_document_freq] : segment_terms) {
+            PostingList::Cursor& cursor = buffers.AcquireCursor(0, *postings);
+            for (cursor.SkipTo(first_slot); cursor.Slot() < end_slot && !should_stop(); cursor.Next()) {
+                ++range_stats.postings_scanned;
+                const int slot = cursor.Slot();
+                if (accumulator.IsExcluded(slot)) {
+                    ++range_stats.documents_excluded;
+                    continue;
+                }
+                if (IsRemoved(slot)) {
+                    continue;
+                }
+                const DocumentSlot& document = slots_[slot];
+                if (document_predicate(document.document_id, document.status, document.rating)) {
+                    accumulator.Add(slot, cursor.TermFreq() * inverse_document_freq);
+                    ++range_stats.documents_scored;
+                }
+            }
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    PhaseTimer top_timer(timed_stats, QueryPhase::TOP_K);
+    accumulator.ForEachScored([this, &top_documents](int slot, double relevance) {
+        const DocumentSlot& document = slots_[slot];
+        top_documents.Add({ document.document_id, relevance, document.rating });
+    });
+    top_timer.Stop();
+    if (stats != nullptr) {
+        stats->Merge(range_stats);
     }
-    return matched_documents;
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(10);
-    const auto query = ParseQuery(raw_query);
+void SearchServer::FindTopDocumentsWithPruning(const std::vector<SegmentTerm>& terms, ScoringBuffers& buffers,
+                                               DocumentPredicate document_predicate, int first_slot, int end_slot,
+                                               TopDocuments& top_documents, StopCheck& should_stop, QueryStats& range_stats) const {
+    // MaxScore: terms whose summed upper bounds cannot reach the current top on their own are
+    // non-essential, so only documents from the essential terms are visited and the rest is probed
+    for (size_t term_index = 0; term_index < terms.size(); ++term_index) {
+        buffers.AcquireCursor(term_index, *terms[term_index].postings).SkipTo(first_slot);
+    }
+    std::vector<TermCursor>& cursors = buffers.term_cursors;
+    cursors.clear();
+    for (size_t term_index = 0; term_index < terms.size(); ++term_index) {
+        const auto [postings, inverse_document_freq] = terms[term_index];
+        // the bound is slightly widened, the real score is summed in another order and may round up
+        const double upper_bound = postings->MaxTermFreq() * inverse_document_freq * (1.0 + 1e-9);
+        cursors.push_back({ &buffers.cursors[term_index], upper_bound, term_index });
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.upper_bound < rhs.upper_bound;
+    });
 
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](std::string_view word) 
-        {
-            if (ids_to_document_freqs_.count(word)) 
-            {
-                for (const auto [document_id, _] : ids_to_document_freqs_.at(word)) 
-                {
-                    document_to_relevance.Erase(document_id);
-                }
+    // bound_prefix[i] is the best score the cursors [0, i) can add together
+    std::vector<double>& bound_prefix = buffers.bound_prefix;
+    bound_prefix.assign(cursors.size() + 1, 0.0);
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        bound_prefix[i + 1] = bound_prefix[i] + cursors[i].upper_bound;
+    }
+
+    std::vector<double>& matched_term_freqs = buffers.matched_term_freqs;
+    matched_term_freqs.assign(terms.size(), 0.0);
+    std::vector<char>& is_matched = buffers.is_matched;
+    is_matched.assign(terms.size(), false);
+    size_t first_essential = 0;
+    // the top may already be filled from the previous segments
+    const auto update_first_essential = [&]() {
+        if (top_documents.IsFull()) {
+            const double threshold = top_documents.Weakest().relevance - EPSILON;
+            while (first_essential < cursors.size() && bound_prefix[first_essential + 1] <= threshold) {
+                ++first_essential;
             }
-    });
+        }
+    };
+    update_first_essential();
 
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [this, &document_predicate, &document_to_relevance](std::string_view word) 
-        {
-            if (ids_to_document_freqs_.count(word)) 
-            {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : ids_to_document_freqs_.at(word)) 
-                {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) 
-                    {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
-                }
+    while (first_essential < cursors.size() && !should_stop()) {
+        int slot = PostingList::END_SLOT;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            slot = std::min(slot, cursors[i].cursor->Slot());
+        }
+        if (slot >= end_slot) {
+            return;
+        }
+
+        std::fill(is_matched.begin(), is_matched.end(), false);
+        double essential_score = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            auto& cursor = *cursors[i].cursor;
+            if (cursor.Slot() == slot) {
+                matched_term_freqs[cursors[i].term_index] = cursor.TermFreq();
+                is_matched[cursors[i].term_index] = true;
+                essential_score += cursor.TermFreq() * terms[cursors[i].term_index].inverse_document_freq;
+                cursor.Next();
+                ++range_stats.postings_scanned;
             }
-    });
+        }
 
-    std::map<int, double> document_to_relevance_reduced = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(document_to_relevance_reduced.size());
+        if (buffers.accumulator.IsExcluded(slot)) {
+            ++range_stats.documents_excluded;
+            continue;
+        }
+        const DocumentSlot& document = slots_[slot];
+        if (IsRemoved(slot) || !document_predicate(document.document_id, document.status, document.rating)) {
+            continue;
+        }
 
-    for (const auto [document_id, relevance] : document_to_relevance_reduced)
-    {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        // relevance is never negative, so an unfilled top accepts everything
+        const double threshold = top_documents.IsFull() ? top_documents.Weakest().relevance - EPSILON : -1.0;
+        bool is_pruned = false;
+        for (size_t i = first_essential; i > 0; --i) {
+            if (essential_score * (1.0 + 1e-9) + bound_prefix[i] <= threshold) {
+                is_pruned = true;
+                break;
+            }
+            auto& cursor = *cursors[i - 1].cursor;
+            cursor.SkipTo(slot);
+            ++range_stats.postings_scanned;
+            if (cursor.Slot() == slot) {
+                matched_term_freqs[cursors[i - 1].term_index] = cursor.TermFreq();
+                is_matched[cursors[i - 1].term_index] = true;
+                essential_score += cursor.TermFreq() * terms[cursors[i - 1].term_index].inverse_document_freq;
+            }
+        }
+        if (is_pruned || (first_essential == 0 && essential_score * (1.0 + 1e-9) <= threshold)) {
+            continue;
+        }
+
+        // same summation order as the exhaustive path, so the relevance is bit-identical
+        double relevance = 0.0;
+        for (size_t term_index = 0; term_index < terms.size(); ++term_index) {
+            if (is_matched[term_index]) {
+                relevance += matched_term_freqs[term_index] * terms[term_index].inverse_document_freq;
+            }
+        }
+        top_documents.Add({ document.document_id, relevance, document.rating });
+        ++range_stats.documents_scored;
+        update_first_essential();
     }
-    return matched_documents;
 }
 
-
 template <typename ExecutionPolicy>
-void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (ids_to_word_freqs_.count(document_id)) {
-        const std::map<std::string_view, double>& word_freqs = ids_to_word_freqs_.at(document_id);
-        std::vector<std::string*> words(word_freqs.size());
-
-        std::transform(policy,
-            word_freqs.begin(), word_freqs.end(),
-            words.begin(),
-            [](const auto& item) { return &item.first; }
-        );
-
-        std::for_each(policy,
-            words.begin(), words.end(), 
-            [this, document_id](std::string* item) {
-                ids_to_document_freqs_.at(*item).erase(document_id);
-        });
+void SearchServer::RemoveDocument(ExecutionPolicy&&, int document_id) {
+    const auto document = FindDocument(document_id);
+    if (!document) {
+        return;
+    }
+
+    // the postings stay, the removed slot is skipped until its segment is sealed or merged
+    const int slot = document->slot;
+    const bool is_sealed = slot < first_mutable_slot_;
+    std::vector<TermId> term_ids;
+    GetDocumentTerms(*document, term_ids);
+    for (const TermId term_id : term_ids) {
+        --document_freqs_.Mutable(term_id);
+        ReclaimTerm(term_id);
+    }
 
-        ids_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+    MarkSlotRemoved(slot);
+    EraseDocument(document_id);
+    if (auto_merge_segments_ && is_sealed) {
+        MergeSegments();
     }
 }
@@ -0,0 +1,339 @@
+// Benchmark of the search hot paths on a synthetic corpus, built as a separate program
+// next to main.cpp. Prints one JSON object with throughput and latency percentiles per
+// benchmark, so the runs of two revisions can be compared by a script.
+//
+//     search_server_benchmark [--documents N] [--document-length N] [--vocabulary N]
+//                             [--zipf-exponent X] [--queries N] [--query-length N] [--seed N]
+
+#include "concurrent_map.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkConfig {
+    size_t document_count = 100000;
+    size_t document_length = 40;
+    size_t vocabulary_size = 50000;
+    double zipf_exponent = 1.0;
+    size_t query_count = 2000;
+    size_t query_length = 4;
+    uint32_t seed = 42;
+};
+
+// Words drawn from a Zipf distribution over the vocabulary: the word of rank k
+// has a probability proportional to 1 / k^exponent, as in natural text.
+class ZipfWordGenerator {
+public:
+    ZipfWordGenerator(size_t vocabulary_size, double exponent, uint32_t seed)
+        : random_(seed)
+    {
+        words_.reserve(vocabulary_size);
+        cumulative_weights_.reserve(vocabulary_size);
+        double total_weight = 0.0;
+        for (size_t rank = 1; rank <= vocabulary_size; ++rank) {
+            words_.push_back("w"s + std::to_string(rank));
+            total_weight += 1.0 / std::pow(static_cast<double>(rank), exponent);
+            cumulative_weights_.push_back(total_weight);
+        }
+    }
+
+    const std::string& NextWord() {
+        std::uniform_real_distribution<double> distribution(0.0, cumulative_weights_.back());
+        const auto it = std::lower_bound(cumulative_weights_.begin(), cumulative_weights_.end(), distribution(random_));
+        return words_[std::min(static_cast<size_t>(it - cumulative_weights_.begin()), words_.size() - 1)];
+    }
+
+    std::string NextText(size_t word_count) {
+        std::string text;
+        for (size_t i = 0; i < word_count; ++i) {
+            if (i > 0) {
+                text += ' ';
+            }
+            text += NextWord();
+        }
+        return text;
+    }
+
+    std::mt19937& GetRandom() {
+        return random_;
+    }
+
+private:
+    std::mt19937 random_;
+    std::vector<std::string> words_;
+    std::vector<double> cumulative_weights_;
+};
+
+struct Corpus {
+    std::vector<std::string> texts;
+    std::vector<DocumentStatus> statuses;
+    std::vector<std::vector<int>> ratings;
+    std::vector<std::string> queries;
+};
+
+Corpus GenerateCorpus(const BenchmarkConfig& config) {
+    ZipfWordGenerator generator(config.vocabulary_size, config.zipf_exponent, config.seed);
+    std::mt19937& random = generator.GetRandom();
+    Corpus corpus;
+    for (size_t i = 0; i < config.document_count; ++i) {
+        // document lengths vary around the configured one
+        const size_t length = std::max<size_t>(1, config.document_length / 2 + random() % (config.document_length + 1));
+        corpus.texts.push_back(generator.NextText(length));
+        corpus.statuses.push_back(random() % 10 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL);
+        corpus.ratings.push_back({ static_cast<int>(random() % 11) - 5, static_cast<int>(random() % 11) - 5 });
+    }
+    for (size_t i = 0; i < config.query_count; ++i) {
+        std::string query = generator.NextText(config.query_length);
+        if (random() % 4 == 0) {
+            query += " -"s + generator.NextWord();
+        }
+        corpus.queries.push_back(std::move(query));
+    }
+    return corpus;
+}
+
+// every operation is timed on its own, the benchmarks take the percentiles from these samples
+class LatencySamples {
+public:
+    template <typename Operation>
+    void Measure(Operation operation) {
+        const auto start_time = Clock::now();
+        operation();
+        samples_.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time).count());
+    }
+
+    // an operation covering several items, e.g. a batch of queries
+    void SetItemsPerSample(size_t item_count) {
+        items_per_sample_ = item_count;
+    }
+
+    void PrintJson(std::ostream& out, const std::string& name) {
+        std::sort(samples_.begin(), samples_.end());
+        const double seconds = std::accumulate(samples_.begin(), samples_.end(), 0.0) / 1e9;
+        const size_t item_count = samples_.size() * items_per_sample_;
+        out << "    {\"name\": \""s << name << "\", \"operations\": "s << item_count
+            << ", \"seconds\": "s << seconds
+            << ", \"throughput_per_second\": "s << (seconds > 0.0 ? item_count / seconds : 0.0)
+            << ", \"latency_ns\": {\"p50\": "s << Percentile(0.5) << ", \"p99\": "s << Percentile(0.99)
+            << ", \"p999\": "s << Percentile(0.999) << ", \"max\": "s << (samples_.empty() ? 0 : samples_.back()) << "}}"s;
+    }
+
+private:
+    std::vector<int64_t> samples_;
+    size_t items_per_sample_ = 1;
+
+    int64_t Percentile(double rank) const {
+        if (samples_.empty()) {
+            return 0;
+        }
+        return samples_[std::min(samples_.size() - 1, static_cast<size_t>(rank * samples_.size()))];
+    }
+};
+
+class BenchmarkReport {
+public:
+    explicit BenchmarkReport(std::ostream& out)
+        : out_(out)
+    {
+    }
+
+    void Add(const std::string& name, LatencySamples& samples) {
+        out_ << (is_first_ ? "\n"s : ",\n"s);
+        is_first_ = false;
+        samples.PrintJson(out_, name);
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+    bool is_first_ = true;
+};
+
+SearchServer BuildServer(const Corpus& corpus, size_t document_count) {
+    SearchServer search_server("and with of"s);
+    for (size_t i = 0; i < document_count; ++i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.texts[i], corpus.statuses[i], corpus.ratings[i]);
+    }
+    return search_server;
+}
+
+void RunBenchmarks(const BenchmarkConfig& config, std::ostream& out) {
+    const Corpus corpus = GenerateCorpus(config);
+    BenchmarkReport report(out);
+    std::mt19937 random(config.seed);
+
+    SearchServer search_server("and with of"s);
+    {
+        LatencySamples samples;
+        for (size_t i = 0; i < corpus.texts.size(); ++i) {
+            samples.Measure([&]() {
+                search_server.AddDocument(static_cast<int>(i), corpus.texts[i], corpus.statuses[i], corpus.ratings[i]);
+            });
+        }
+        report.Add("add_document"s, samples);
+    }
+    {
+        const size_t batch_size = 1000;
+        SearchServer batch_server("and with of"s);
+        LatencySamples samples;
+        samples.SetItemsPerSample(batch_size);
+        std::vector<NewDocument> batch;
+        for (size_t first = 0; first + batch_size <= corpus.texts.size(); first += batch_size) {
+            batch.clear();
+            for (size_t i = first; i < first + batch_size; ++i) {
+                batch.push_back({ static_cast<int>(i), corpus.texts[i], corpus.statuses[i], corpus.ratings[i] });
+            }
+            samples.Measure([&]() {
+                batch_server.AddDocuments(std::execution::par, batch);
+            });
+        }
+        report.Add("add_documents_par_batch_1000"s, samples);
+    }
+
+    const auto run_queries = [&](const std::string& name, const std::function<void(const std::string&)>& query) {
+        LatencySamples samples;
+        for (const std::string& raw_query : corpus.queries) {
+            samples.Measure([&]() {
+                query(raw_query);
+            });
+        }
+        report.Add(name, samples);
+    };
+    run_queries("find_top_documents_seq"s, [&](const std::string& raw_query) {
+        search_server.FindTopDocuments(std::execution::seq, raw_query);
+    });
+    run_queries("find_top_documents_par"s, [&](const std::string& raw_query) {
+        search_server.FindTopDocuments(std::execution::par, raw_query);
+    });
+    SearchServer::QueryContext context;
+    run_queries("find_top_documents_context"s, [&](const std::string& raw_query) {
+        search_server.FindTopDocuments(context, raw_query);
+    });
+    run_queries("match_document_seq"s, [&](const std::string& raw_query) {
+        search_server.MatchDocument(std::execution::seq, raw_query, static_cast<int>(random() % corpus.texts.size()));
+    });
+    run_queries("match_document_par"s, [&](const std::string& raw_query) {
+        search_server.MatchDocument(std::execution::par, raw_query, static_cast<int>(random() % corpus.texts.size()));
+    });
+    {
+        LatencySamples samples;
+        samples.SetItemsPerSample(corpus.queries.size());
+        for (int run = 0; run < 5; ++run) {
+            samples.Measure([&]() {
+                ProcessQueries(search_server, corpus.queries);
+            });
+        }
+        report.Add("process_queries_batch"s, samples);
+    }
+    {
+        // increments of one key per document slot, spread over all hardware threads
+        std::vector<int> keys(corpus.texts.size() * 4);
+        for (int& key : keys) {
+            key = static_cast<int>(random() % corpus.texts.size());
+        }
+        LatencySamples samples;
+        samples.SetItemsPerSample(keys.size());
+        for (int run = 0; run < 5; ++run) {
+            ConcurrentMap<int, double> scores;
+            samples.Measure([&]() {
+                std::for_each(std::execution::par, keys.begin(), keys.end(), [&scores](int key) {
+                    scores[key].ref_to_value += 1.0;
+                });
+            });
+        }
+        report.Add("concurrent_map_add_par"s, samples);
+    }
+    {
+        LatencySamples samples;
+        for (size_t i = 0; i < corpus.texts.size(); i += 10) {
+            samples.Measure([&]() {
+                search_server.RemoveDocument(static_cast<int>(i));
+            });
+        }
+        report.Add("remove_document"s, samples);
+    }
+    {
+        // every tenth document repeats an earlier one, RemoveDuplicates would print their ids
+        SearchServer duplicates_server = BuildServer(corpus, corpus.texts.size() / 2);
+        for (size_t i = 0; i < corpus.texts.size() / 20; ++i) {
+            duplicates_server.AddDocument(static_cast<int>(corpus.texts.size() + i), corpus.texts[i], DocumentStatus::ACTUAL, {});
+        }
+        LatencySamples samples;
+        samples.Measure([&]() {
+            duplicates_server.RemoveDocuments(std::execution::par, FindDuplicates(duplicates_server));
+        });
+        report.Add("remove_duplicates"s, samples);
+    }
+}
+
+BenchmarkConfig ParseArguments(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (i + 1 == argc) {
+            throw std::invalid_argument("no value after "s + argument);
+        }
+        const std::string value = argv[++i];
+        if (argument == "--documents") {
+            config.document_count = std::stoul(value);
+        } else if (argument == "--document-length") {
+            config.document_length = std::stoul(value);
+        } else if (argument == "--vocabulary") {
+            config.vocabulary_size = std::stoul(value);
+        } else if (argument == "--zipf-exponent") {
+            config.zipf_exponent = std::stod(value);
+        } else if (argument == "--queries") {
+            config.query_count = std::stoul(value);
+        } else if (argument == "--query-length") {
+            config.query_length = std::stoul(value);
+        } else if (argument == "--seed") {
+            config.seed = static_cast<uint32_t>(std::stoul(value));
+        } else {
+            throw std::invalid_argument("unknown option "s + argument);
+        }
+    }
+    if (config.document_count == 0 || config.document_length == 0 || config.vocabulary_size == 0 || config.query_length == 0) {
+        throw std::invalid_argument("the corpus sizes must be positive"s);
+    }
+    return config;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const BenchmarkConfig config = ParseArguments(argc, argv);
+        std::cout << "{\n  \"config\": {\"documents\": "s << config.document_count
+                  << ", \"document_length\": "s << config.document_length
+                  << ", \"vocabulary\": "s << config.vocabulary_size
+                  << ", \"zipf_exponent\": "s << config.zipf_exponent
+                  << ", \"queries\": "s << config.query_count
+                  << ", \"query_length\": "s << config.query_length
+                  << ", \"seed\": "s << config.seed << "},\n  \"benchmarks\": ["s;
+        RunBenchmarks(config, std::cout);
+        std::cout << "\n  ]\n}"s << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,712 @@
+// Tests of the search server, built as a separate program next to main.cpp. The
+// randomized ones check the server against a brute-force model of the index or one
+// configuration of the server against another on random corpora and queries.
+
+#include "search_server.h"
+#include "document_ingestion.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "query_executor.h"
+#include "versioned_search_server.h"
+#include "test_framework.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+// the size of a block is kept in front of it, the header keeps the alignment of malloc
+constexpr size_t ALLOCATION_HEADER_SIZE = alignof(std::max_align_t);
+
+std::atomic<size_t> allocation_count{ 0 };
+std::atomic<size_t> allocated_size{ 0 };
+
+}  // namespace
+
+// counts the allocations of the whole program and the bytes in use, the tests compare
+// the counts before and after
+void* operator new(std::size_t size) {
+    void* block = std::malloc(size + ALLOCATION_HEADER_SIZE);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *static_cast<std::size_t*>(block) = size;
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_size.fetch_add(size, std::memory_order_relaxed);
+    return static_cast<char*>(block) + ALLOCATION_HEADER_SIZE;
+}
+
+// GCC inlines these into the standard containers, takes the memory of operator new for
+// a mismatch though both ends are replaced here, and the header for out of bounds
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#endif
+
+void operator delete(void* memory) noexcept {
+    if (memory == nullptr) {
+        return;
+    }
+    char* const block = static_cast<char*>(memory) - ALLOCATION_HEADER_SIZE;
+    allocated_size.fetch_sub(*reinterpret_cast<std::size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+const std::string STOP_WORDS = "w0 w1"s;
+const int VOCABULARY_SIZE = 60;
+
+struct ModelDocument {
+    std::map<std::string, int> word_counts;
+    int word_count = 0;
+    int rating = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+};
+
+// The index as a plain map of documents, scored by walking all of them.
+class IndexModel {
+public:
+    explicit IndexModel(uint32_t seed)
+        : random_(seed)
+    {
+    }
+
+    std::mt19937& GetRandom() {
+        return random_;
+    }
+
+    std::string MakeWord() {
+        // skewed to the low words, so some words are common and some are rare
+        const int rank = std::min<int>(random_() % VOCABULARY_SIZE, random_() % VOCABULARY_SIZE);
+        return "w"s + std::to_string(rank);
+    }
+
+    // adds the same document to every server
+    void AddDocument(const std::vector<SearchServer*>& search_servers, int document_id) {
+        ModelDocument document;
+        std::string text;
+        const int length = random_() % 12;
+        for (int i = 0; i < length; ++i) {
+            const std::string word = MakeWord();
+            text += word + ' ';
+            if (!IsStopWord(word)) {
+                ++document.word_counts[word];
+                ++document.word_count;
+            }
+        }
+        document.rating = static_cast<int>(random_() % 10) - 3;
+        document.status = random_() % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        for (SearchServer* search_server : search_servers) {
+            search_server->AddDocument(document_id, text, document.status, { document.rating });
+        }
+        documents_[document_id] = std::move(document);
+    }
+
+    void RemoveDocument(const std::vector<SearchServer*>& search_servers, int document_id) {
+        for (SearchServer* search_server : search_servers) {
+            search_server->RemoveDocument(document_id);
+        }
+        documents_.erase(document_id);
+    }
+
+    int GetRandomDocumentId() {
+        auto it = documents_.begin();
+        std::advance(it, random_() % documents_.size());
+        return it->first;
+    }
+
+    bool HasDocument(int document_id) const {
+        return documents_.count(document_id) > 0;
+    }
+
+    std::string MakeQuery() {
+        std::string query;
+        const int length = 1 + random_() % 5;
+        for (int i = 0; i < length; ++i) {
+            query += (random_() % 5 == 0 ? "-"s : ""s) + MakeWord() + ' ';
+        }
+        return query;
+    }
+
+    std::vector<Document> FindAllDocuments(const std::string& raw_query) const {
+        std::set<std::string> plus_words;
+        std::set<std::string> minus_words;
+        for (const std::string& word : SplitQuery(raw_query)) {
+            if (word[0] == '-') {
+                minus_words.insert(word.substr(1));
+            } else {
+                plus_words.insert(word);
+            }
+        }
+        std::map<std::string, int> document_freqs;
+        for (const auto& [document_id, document] : documents_) {
+            for (const auto& [word, count] : document.word_counts) {
+                ++document_freqs[word];
+            }
+        }
+
+        std::vector<Document> result;
+        for (const auto& [document_id, document] : documents_) {
+            if (document.status != DocumentStatus::ACTUAL) {
+                continue;
+            }
+            const bool is_excluded = std::any_of(minus_words.begin(), minus_words.end(), [&document](const std::string& word) {
+                return document.word_counts.count(word) > 0;
+            });
+            if (is_excluded) {
+                continue;
+            }
+            double relevance = 0.0;
+            bool has_plus_word = false;
+            for (const std::string& word : plus_words) {
+                const auto it = document.word_counts.find(word);
+                if (it == document.word_counts.end()) {
+                    continue;
+                }
+                has_plus_word = true;
+                const double inverse_document_freq = std::log(static_cast<double>(documents_.size()))
+                                                     - std::log(static_cast<double>(document_freqs[word]));
+                relevance += static_cast<double>(it->second) / document.word_count * inverse_document_freq;
+            }
+            if (has_plus_word) {
+                result.push_back({ document_id, relevance, document.rating });
+            }
+        }
+        std::sort(result.begin(), result.end(), IsMoreRelevant);
+        return result;
+    }
+
+private:
+    std::mt19937 random_;
+    std::map<int, ModelDocument> documents_;
+
+    static bool IsStopWord(const std::string& word) {
+        return word == "w0"s || word == "w1"s;
+    }
+
+    static std::vector<std::string> SplitQuery(const std::string& raw_query) {
+        std::vector<std::string> words;
+        std::string word;
+        for (const char c : raw_query + ' ') {
+            if (c != ' ') {
+                word += c;
+            } else if (!word.empty()) {
+                if (!IsStopWord(word[0] == '-' ? word.substr(1) : word)) {
+                    words.push_back(word);
+                }
+                word.clear();
+            }
+        }
+        return words;
+    }
+};
+
+// The relevances are summed in another order than by the model, so they are compared with
+// a tolerance, and documents of equal relevance may come in any order.
+void AssertSameTop(const std::vector<Document>& documents, const std::vector<Document>& expected, size_t max_document_count,
+                   const std::string& hint) {
+    const double tolerance = 1e-9;
+    AssertEqual(documents.size(), std::min(expected.size(), max_document_count), hint);
+    std::map<int, double> expected_relevances;
+    for (const Document& document : expected) {
+        expected_relevances[document.id] = document.relevance;
+    }
+    for (size_t i = 0; i < documents.size(); ++i) {
+        Assert(std::abs(documents[i].relevance - expected[i].relevance) < tolerance, hint + ", position "s + std::to_string(i));
+        const auto it = expected_relevances.find(documents[i].id);
+        Assert(it != expected_relevances.end() && std::abs(it->second - documents[i].relevance) < tolerance,
+               hint + ", document "s + std::to_string(documents[i].id));
+    }
+}
+
+// Queries of several plus words go through MaxScore pruning, which must find the same top
+// as scoring every document, for any number of segments and any result size. A limit past
+// the number of matches returns them all.
+void TestMaxScorePruningMatchesExhaustiveScoring() {
+    for (const size_t segment_document_count : { 7, 50, 100000 }) {
+        for (uint32_t seed = 1; seed <= 3; ++seed) {
+            IndexModel model(seed);
+            SearchServer search_server(STOP_WORDS);
+            search_server.SetSegmentDocumentCount(segment_document_count);
+            int next_document_id = 0;
+            for (int i = 0; i < 600; ++i) {
+                model.AddDocument({ &search_server }, next_document_id += 1 + model.GetRandom()() % 3);
+            }
+            for (int i = 0; i < 100; ++i) {
+                model.RemoveDocument({ &search_server }, model.GetRandomDocumentId());
+            }
+            for (int i = 0; i < 300; ++i) {
+                const std::string query = model.MakeQuery();
+                const std::vector<Document> expected = model.FindAllDocuments(query);
+                for (const size_t max_document_count : { size_t{ 1 }, size_t{ 5 }, size_t{ 20 }, std::numeric_limits<size_t>::max() }) {
+                    const std::string hint = "query \""s + query + "\", top "s + std::to_string(max_document_count);
+                    AssertSameTop(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_document_count), expected,
+                                  max_document_count, hint);
+                    AssertSameTop(search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, max_document_count),
+                                  expected, max_document_count, hint + ", par"s);
+                }
+            }
+        }
+    }
+}
+
+// Compressed postings decode to the same slots and term frequencies as plain ones, so the
+// results must be equal exactly, also for lists compressed and unpacked between updates.
+void TestCompressedPostingsMatchPlainPostings() {
+    for (const size_t segment_document_count : { 7, 300, 100000 }) {
+        IndexModel model(segment_document_count);
+        SearchServer plain_server(STOP_WORDS);
+        SearchServer compressed_server(STOP_WORDS);
+        SearchServer switched_server(STOP_WORDS);
+        const std::vector<SearchServer*> search_servers = { &plain_server, &compressed_server, &switched_server };
+        for (SearchServer* search_server : search_servers) {
+            search_server->SetSegmentDocumentCount(segment_document_count);
+        }
+        compressed_server.SetPostingCompression(true);
+
+        int next_document_id = 0;
+        for (int round = 0; round < 6; ++round) {
+            switched_server.SetPostingCompression(round % 2 == 1);
+            // enough documents to fill whole blocks of the common words
+            for (int i = 0; i < 500; ++i) {
+                model.AddDocument(search_servers, next_document_id += 1 + model.GetRandom()() % 3);
+            }
+            for (int i = 0; i < 150; ++i) {
+                model.RemoveDocument(search_servers, model.GetRandomDocumentId());
+            }
+            for (int i = 0; i < 100; ++i) {
+                const std::string query = model.MakeQuery();
+                const std::string hint = "query \""s + query + "\", round "s + std::to_string(round);
+                const std::vector<Document> expected = plain_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+                ASSERT_EQUAL(compressed_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20), expected);
+                ASSERT_EQUAL(switched_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20), expected);
+                ASSERT_EQUAL(compressed_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, 20), expected);
+                AssertSameTop(expected, model.FindAllDocuments(query), 20, hint);
+
+                const int document_id = model.GetRandomDocumentId();
+                const auto [expected_words, expected_status] = plain_server.MatchDocument(query, document_id);
+                const auto [words, status] = compressed_server.MatchDocument(query, document_id);
+                AssertEqual(words, expected_words, hint);
+                AssertEqual(static_cast<int>(status), static_cast<int>(expected_status), hint);
+            }
+        }
+    }
+}
+
+// Checks that two servers hold the same documents and answer the same, on random queries.
+void AssertSameIndex(const SearchServer& search_server, const SearchServer& expected, IndexModel& model, const std::string& hint) {
+    AssertEqual(search_server.GetDocumentCount(), expected.GetDocumentCount(), hint);
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    AssertEqual(document_ids, std::vector<int>(expected.begin(), expected.end()), hint);
+    for (const int document_id : document_ids) {
+        AssertEqual(search_server.GetWordFrequencies(document_id), expected.GetWordFrequencies(document_id),
+                    hint + ", document "s + std::to_string(document_id));
+    }
+    for (int i = 0; i < 100; ++i) {
+        const std::string query = model.MakeQuery();
+        AssertEqual(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20), expected.FindTopDocuments(query, DocumentStatus::ACTUAL, 20),
+                    hint + ", query \""s + query + '"');
+        AssertEqual(search_server.FindTopDocuments(query, DocumentStatus::BANNED), expected.FindTopDocuments(query, DocumentStatus::BANNED),
+                    hint + ", query \""s + query + '"');
+        const int document_id = model.GetRandomDocumentId();
+        const auto [words, status] = search_server.MatchDocument(query, document_id);
+        const auto [expected_words, expected_status] = expected.MatchDocument(query, document_id);
+        AssertEqual(words, expected_words, hint + ", query \""s + query + '"');
+        AssertEqual(static_cast<int>(status), static_cast<int>(expected_status), hint);
+    }
+}
+
+// A loaded index answers like the saved one and keeps doing so under the same updates,
+// which change the documents served from the mapped file as well as add new ones.
+void TestSaveLoadRoundTrip() {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_tests.idx").string();
+    for (const bool compress_postings : { false, true }) {
+        for (const size_t segment_document_count : { 7, 300, 100000 }) {
+            const std::string hint = "compression "s + std::to_string(compress_postings) + ", segment "s + std::to_string(segment_document_count);
+            IndexModel model(static_cast<uint32_t>(segment_document_count));
+            SearchServer search_server(STOP_WORDS);
+            search_server.SetSegmentDocumentCount(segment_document_count);
+            search_server.SetPostingCompression(compress_postings);
+            int next_document_id = 0;
+            for (int i = 0; i < 1000; ++i) {
+                model.AddDocument({ &search_server }, next_document_id += 1 + model.GetRandom()() % 3);
+            }
+            for (int i = 0; i < 200; ++i) {
+                model.RemoveDocument({ &search_server }, model.GetRandomDocumentId());
+            }
+
+            search_server.Save(path);
+            SearchServer loaded_server = SearchServer::Load(path);
+            AssertSameIndex(loaded_server, search_server, model, hint);
+
+            // the ids of removed loaded documents may be taken again
+            const std::vector<SearchServer*> search_servers = { &search_server, &loaded_server };
+            for (int i = 0; i < 300; ++i) {
+                model.RemoveDocument(search_servers, model.GetRandomDocumentId());
+            }
+            for (int i = 0; i < 300; ++i) {
+                const bool is_free = !model.HasDocument(2 * i + 1);
+                model.AddDocument(search_servers, is_free ? 2 * i + 1 : next_document_id += 1 + model.GetRandom()() % 3);
+            }
+            AssertSameIndex(loaded_server, search_server, model, hint + ", after updates"s);
+
+            // a loaded index is saved again from the blocks of the first file
+            loaded_server.Save(path + ".2"s);
+            const SearchServer reloaded_server = SearchServer::Load(path + ".2"s);
+            AssertSameIndex(reloaded_server, search_server, model, hint + ", reloaded"s);
+            std::remove((path + ".2"s).c_str());
+        }
+    }
+
+    // damaged tables are rejected on every load, damaged postings when the whole file is checked;
+    // the last section is the encoded postings, followed by its checksum and the padding
+    for (const std::streamoff offset : { std::streamoff(40), std::streamoff(-30) }) {
+        SearchServer search_server(STOP_WORDS);
+        search_server.AddDocument(1, "w5 w6 w7"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.Save(path);
+        ASSERT_EQUAL(SearchServer::Load(path, SnapshotCheck::FULL).FindTopDocuments("w6"s).size(), 1u);
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(offset, offset < 0 ? std::ios::end : std::ios::beg);
+        const char byte = static_cast<char>(file.get());
+        file.seekp(offset, offset < 0 ? std::ios::end : std::ios::beg);
+        file.put(static_cast<char>(byte ^ 0x7f));
+        file.close();
+        ASSERT_THROWS(SearchServer::Load(path, SnapshotCheck::FULL), std::runtime_error);
+        if (offset > 0) {
+            ASSERT_THROWS(SearchServer::Load(path), std::runtime_error);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// Once its buffers have grown, a query context serves queries without allocating.
+void TestQueryContextDoesNotAllocate() {
+    for (const bool compress_postings : { false, true }) {
+        IndexModel model(11);
+        SearchServer search_server(STOP_WORDS);
+        search_server.SetSegmentDocumentCount(300);
+        search_server.SetPostingCompression(compress_postings);
+        for (int document_id = 0; document_id < 2000; ++document_id) {
+            model.AddDocument({ &search_server }, document_id);
+        }
+        for (int i = 0; i < 300; ++i) {
+            model.RemoveDocument({ &search_server }, model.GetRandomDocumentId());
+        }
+        std::vector<std::string> queries(200);
+        std::vector<int> document_ids(queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            queries[i] = model.MakeQuery();
+            document_ids[i] = model.GetRandomDocumentId();
+        }
+
+        SearchServer::QueryContext context;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT_EQUAL(search_server.FindTopDocuments(context, queries[i]), search_server.FindTopDocuments(queries[i]));
+            search_server.FindTopDocuments(context, queries[i], DocumentStatus::BANNED, 3);
+            search_server.MatchDocument(context, queries[i], document_ids[i]);
+        }
+        const size_t allocation_count_before = allocation_count.load();
+        for (int round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                search_server.FindTopDocuments(context, queries[i]);
+                search_server.FindTopDocuments(context, queries[i], DocumentStatus::BANNED, 3);
+                search_server.MatchDocument(context, queries[i], document_ids[i]);
+            }
+        }
+        // read before ASSERT_EQUAL, it allocates its message
+        const size_t query_allocation_count = allocation_count.load() - allocation_count_before;
+        ASSERT_EQUAL(query_allocation_count, size_t{ 0 });
+    }
+}
+
+// Every update of a versioned server copies the index, the copy must share the texts
+// and the tables instead of growing them.
+void TestVersionedUpdatesShareStorage() {
+    const size_t allocated_size_before = allocated_size.load();
+    {
+        VersionedSearchServer search_server{ SearchServer(STOP_WORDS) };
+        const int document_count = 2000;
+        for (int document_id = 0; document_id < document_count; ++document_id) {
+            search_server.AddDocument(document_id, "w5 w6 w"s + std::to_string(document_id % 50), DocumentStatus::ACTUAL, { 1 });
+        }
+        ASSERT_EQUAL(search_server.GetSnapshot()->GetDocumentCount(), document_count);
+        // a text chunk per version took 2000 MiB here
+        const size_t index_size = allocated_size.load() - allocated_size_before;
+        ASSERT(index_size < 8 * TextArena::CHUNK_SIZE);
+    }
+    const size_t leaked_size = allocated_size.load() - allocated_size_before;
+    ASSERT_EQUAL(leaked_size, size_t{ 0 });
+}
+
+void TestNestedQueryExecutorRun() {
+    QueryExecutor executor(2);
+    const size_t outer_count = 8;
+    const size_t inner_count = 10;
+    std::vector<int> counts(outer_count * inner_count, 0);
+    // a task that runs a batch on its own executor used to wait for itself
+    executor.Run(outer_count, [&](size_t outer) {
+        executor.Run(inner_count, [&](size_t inner) {
+            ++counts[outer * inner_count + inner];
+        });
+    });
+    ASSERT(std::all_of(counts.begin(), counts.end(), [](int count) { return count == 1; }));
+
+    ASSERT_THROWS(executor.Run(outer_count, [&](size_t outer) {
+        executor.Run(inner_count, [](size_t inner) {
+            if (inner == 3) {
+                throw std::invalid_argument("task failed"s);
+            }
+        });
+    }), std::invalid_argument);
+}
+
+// A malformed record or one the server rejects is reported with its line and skipped, the
+// records around it are ingested, also when the blocks cut the file into pieces of a line or two.
+void TestIngestionSkipsMalformedRecords() {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_tests.tsv").string();
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "1\tACTUAL\t1 2\tw1 w2\n"s
+             << "2\tACTUAL\t3\n"s
+             << "\n"s
+             << "3\tDELETED\t1\tw3\n"s
+             << "4\tBANNED\t\tw4 w5\r\n"s
+             << "x5\tACTUAL\t1\tw5\n"s
+             << "6\tACTUAL\t1 y\tw6\n"s
+             // a control character in the text, an id repeated in the file and one in the index
+             << "8\tACTUAL\t1\tw8\tw9\n"s
+             << "1\tACTUAL\t1\tw1 w3\n"s
+             << "9\tACTUAL\t2\tw9\n"s
+             << "9\tACTUAL\t2\tw9 w10\n"s
+             << "100\tACTUAL\t1\tw10\n"s
+             << "7\tIRRELEVANT\t-1\tw7"s;
+    }
+    for (const size_t block_size : { size_t{ 1 } << 20, size_t{ 16 } }) {
+        SearchServer search_server(STOP_WORDS);
+        search_server.AddDocument(100, "w10 w11"s, DocumentStatus::ACTUAL, { 1 });
+        IngestionOptions options;
+        options.block_size = block_size;
+        std::vector<std::string> reports;
+        options.report_malformed_record = [&reports](const std::string& report) {
+            reports.push_back(report);
+        };
+        const IngestionStats stats = IngestDocuments(search_server, path, options);
+        ASSERT_EQUAL(stats.document_count, size_t{ 4 });
+        ASSERT_EQUAL(stats.skipped_record_count, size_t{ 8 });
+        ASSERT_EQUAL(std::vector<int>(search_server.begin(), search_server.end()), std::vector<int>({ 1, 4, 7, 9, 100 }));
+        // the first of the records with an id is kept
+        ASSERT(search_server.FindTopDocuments("w3"s).empty());
+        ASSERT_EQUAL(search_server.FindTopDocuments("w10"s).size(), size_t{ 1 });
+        ASSERT_EQUAL(reports.size(), size_t{ 8 });
+        std::vector<std::string> prefixes;
+        for (const int line_number : { 2, 4, 6, 7, 8, 9, 11, 12 }) {
+            prefixes.push_back(path + ":"s + std::to_string(line_number) + ":"s);
+        }
+        for (size_t i = 0; i < reports.size(); ++i) {
+            Assert(reports[i].compare(0, prefixes[i].size(), prefixes[i]) == 0, reports[i]);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// A failing query or sink stops the joined processing with its exception instead of
+// leaving the other workers waiting for its output.
+void TestProcessQueriesJoinedStopsOnError() {
+    IndexModel model(13);
+    SearchServer search_server(STOP_WORDS);
+    for (int document_id = 0; document_id < 500; ++document_id) {
+        model.AddDocument({ &search_server }, document_id);
+    }
+    std::vector<std::string> queries(200);
+    for (std::string& query : queries) {
+        query = model.MakeQuery();
+    }
+    std::vector<std::string> bad_queries = queries;
+    bad_queries[3] = "--bad"s;
+    ASSERT_THROWS(ProcessQueries(search_server, bad_queries), std::invalid_argument);
+    ASSERT_THROWS(ProcessQueriesJoined(search_server, bad_queries), std::invalid_argument);
+
+    size_t document_count = 0;
+    ASSERT_THROWS(ProcessQueriesJoined(search_server, queries, [&document_count](const Document&) {
+        if (++document_count == 20) {
+            throw std::runtime_error("sink failed"s);
+        }
+    }), std::runtime_error);
+
+    // the pool is still usable afterwards
+    std::vector<Document> expected;
+    for (const std::vector<Document>& documents : ProcessQueries(search_server, queries)) {
+        expected.insert(expected.end(), documents.begin(), documents.end());
+    }
+    const std::vector<Document> joined = ProcessQueriesJoined(search_server, queries);
+    ASSERT_EQUAL(joined.size(), expected.size());
+    for (size_t i = 0; i < joined.size(); ++i) {
+        ASSERT_EQUAL(joined[i].id, expected[i].id);
+    }
+}
+
+double ComputeJaccardSimilarity(const std::set<std::string>& lhs, const std::set<std::string>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    std::vector<std::string> common;
+    std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::back_inserter(common));
+    return static_cast<double>(common.size()) / (lhs.size() + rhs.size() - common.size());
+}
+
+// FindDuplicates removes what comparing the word sets does, and FindNearDuplicates removes
+// only documents similar enough to a kept one before them, exact duplicates among them.
+// Both run on a loaded copy too, which keeps nothing per document.
+void TestDuplicateDetection() {
+    std::mt19937 random(17);
+    SearchServer search_server(STOP_WORDS);
+    std::map<int, std::set<std::string>> word_sets;
+    for (int document_id = 0; document_id < 3000; ++document_id) {
+        std::string text;
+        std::set<std::string> words;
+        const int length = random() % 7;
+        for (int i = 0; i < length; ++i) {
+            const std::string word = "w"s + std::to_string(std::min(random() % 12, random() % 12));
+            text += word + ' ';
+            if (word != "w0"s && word != "w1"s) {
+                words.insert(word);
+            }
+        }
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { 1 });
+        word_sets[document_id] = std::move(words);
+    }
+    for (int document_id = 0; document_id < 3000; document_id += 7) {
+        search_server.RemoveDocument(document_id);
+        word_sets.erase(document_id);
+    }
+
+    std::vector<int> expected_duplicates;
+    std::set<std::set<std::string>> seen_sets;
+    for (const auto& [document_id, words] : word_sets) {
+        if (!seen_sets.insert(words).second) {
+            expected_duplicates.push_back(document_id);
+        }
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_tests_duplicates.idx").string();
+    search_server.Save(path);
+    const SearchServer loaded_server = SearchServer::Load(path);
+    for (const SearchServer* server : std::vector<const SearchServer*>{ &search_server, &loaded_server }) {
+        const std::vector<int> duplicates = FindDuplicates(*server);
+        ASSERT_EQUAL(duplicates, expected_duplicates);
+        for (const double threshold : { 0.5, 0.8, 1.0 }) {
+            const std::string hint = "threshold "s + std::to_string(threshold);
+            const std::vector<int> near_duplicates = FindNearDuplicates(*server, threshold);
+            const std::set<int> removed(near_duplicates.begin(), near_duplicates.end());
+            Assert(std::includes(removed.begin(), removed.end(), duplicates.begin(), duplicates.end()), hint);
+            for (const int document_id : near_duplicates) {
+                const auto& words = word_sets.at(document_id);
+                const bool has_similar = std::any_of(word_sets.begin(), word_sets.find(document_id), [&](const auto& kept) {
+                    return removed.count(kept.first) == 0 && ComputeJaccardSimilarity(words, kept.second) >= threshold;
+                });
+                Assert(has_similar, hint + ", document "s + std::to_string(document_id));
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// A fired control stops the search and marks itself stopped, the partial top holds only
+// matching documents with their full relevance. An unfired one and the async calls give the
+// same results as the plain calls.
+void TestQueryControlStopsSearch() {
+    IndexModel model(19);
+    SearchServer search_server(STOP_WORDS);
+    for (int document_id = 0; document_id < 20000; ++document_id) {
+        model.AddDocument({ &search_server }, document_id);
+    }
+    const std::string query = "w2 w3 w4 w5 -w40"s;
+    const std::vector<Document> expected = model.FindAllDocuments(query);
+    std::map<int, double> expected_relevances;
+    for (const Document& document : expected) {
+        expected_relevances[document.id] = document.relevance;
+    }
+    const auto assert_partial_top = [&](const std::vector<Document>& documents, const std::string& hint) {
+        Assert(documents.size() <= 20, hint);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const auto it = expected_relevances.find(documents[i].id);
+            Assert(it != expected_relevances.end() && std::abs(it->second - documents[i].relevance) < 1e-9,
+                   hint + ", document "s + std::to_string(documents[i].id));
+            Assert(i == 0 || !IsMoreRelevant(documents[i], documents[i - 1]), hint + ", position "s + std::to_string(i));
+        }
+    };
+
+    QueryControl cancelled;
+    cancelled.Cancel();
+    const std::vector<Document> cancelled_top = search_server.FindTopDocuments(cancelled, query, DocumentStatus::ACTUAL, 20);
+    ASSERT(cancelled.IsStopped());
+    assert_partial_top(cancelled_top, "cancelled"s);
+
+    const QueryControl expired(QueryControl::Clock::now() - std::chrono::seconds(1));
+    assert_partial_top(search_server.FindTopDocuments(expired, query, DocumentStatus::ACTUAL, 20), "expired"s);
+    ASSERT(expired.IsStopped());
+
+    const QueryControl unlimited(std::chrono::hours(1));
+    const std::vector<Document> full_top = search_server.FindTopDocuments(unlimited, query, DocumentStatus::ACTUAL, 20);
+    ASSERT(!unlimited.IsStopped());
+    AssertSameTop(full_top, expected, 20, "unlimited"s);
+
+    std::future<std::vector<Document>> async_top = search_server.FindTopDocumentsAsync(QueryControl(), query, DocumentStatus::ACTUAL, 20);
+    AssertSameTop(async_top.get(), expected, 20, "async"s);
+
+    for (const int document_id : { expected.front().id, expected.back().id, 1, 2, 3 }) {
+        const auto [words, status] = search_server.MatchDocument(query, document_id);
+        const auto [async_words, async_status] = search_server.MatchDocumentAsync(QueryControl(), query, document_id).get();
+        ASSERT_EQUAL(std::vector<std::string>(async_words.begin(), async_words.end()), std::vector<std::string>(words.begin(), words.end()));
+        ASSERT_EQUAL(static_cast<int>(async_status), static_cast<int>(status));
+
+        // stopped among the minus words, nothing is matched
+        QueryControl match_control;
+        match_control.Cancel();
+        ASSERT(std::get<0>(search_server.MatchDocument(match_control, query, document_id)).empty());
+        ASSERT(match_control.IsStopped());
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestMaxScorePruningMatchesExhaustiveScoring);
+    RUN_TEST(tr, TestCompressedPostingsMatchPlainPostings);
+    RUN_TEST(tr, TestSaveLoadRoundTrip);
+    RUN_TEST(tr, TestQueryContextDoesNotAllocate);
+    RUN_TEST(tr, TestVersionedUpdatesShareStorage);
+    RUN_TEST(tr, TestNestedQueryExecutorRun);
+    RUN_TEST(tr, TestIngestionSkipsMalformedRecords);
+    RUN_TEST(tr, TestProcessQueriesJoinedStopsOnError);
+    RUN_TEST(tr, TestDuplicateDetection);
+    RUN_TEST(tr, TestQueryControlStopsSearch);
+}
@@ -0,0 +1,70 @@
+#include "snapshot_documents.h"
+#include "document.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+SnapshotDocuments::SnapshotDocuments(std::shared_ptr<const MappedFile> file, SnapshotReader& reader, SnapshotCheck check)
+    : file_(std::move(file))
+{
+    const auto corrupted = []() {
+        return std::runtime_error("index snapshot is corrupted"s);
+    };
+
+    reader.BeginSection(true);
+    size_ = reader.ReadUint32();
+    reader.Align(alignof(Record));
+    records_ = reinterpret_cast<const Record*>(reader.ReadBytes(size_ * sizeof(Record)));
+    slots_by_id_ = reinterpret_cast<const uint32_t*>(reader.ReadBytes(size_ * sizeof(uint32_t)));
+    uint64_t texts_size = 0;
+    std::memcpy(&texts_size, reader.ReadBytes(sizeof(texts_size)), sizeof(texts_size));
+    reader.EndSection();
+    reader.BeginSection(check == SnapshotCheck::FULL);
+    texts_ = reinterpret_cast<const char*>(reader.ReadBytes(texts_size));
+    reader.EndSection();
+
+    // every slot once and the ids strictly increasing, so no id is repeated
+    for (size_t slot = 0; slot < size_; ++slot) {
+        const Record& record = records_[slot];
+        if (record.document_id < 0 || record.status < 0 || record.status > static_cast<int32_t>(DocumentStatus::REMOVED)
+            || record.text_offset > texts_size || record.text_size > texts_size - record.text_offset) {
+            throw corrupted();
+        }
+    }
+    for (size_t rank = 0; rank < size_; ++rank) {
+        if (slots_by_id_[rank] >= size_
+            || (rank > 0 && records_[slots_by_id_[rank - 1]].document_id >= records_[slots_by_id_[rank]].document_id)) {
+            throw corrupted();
+        }
+    }
+}
+
+size_t SnapshotDocuments::Size() const noexcept {
+    return size_;
+}
+
+const SnapshotDocuments::Record& SnapshotDocuments::GetRecord(int slot) const noexcept {
+    return records_[slot];
+}
+
+std::string_view SnapshotDocuments::GetText(int slot) const noexcept {
+    return { texts_ + records_[slot].text_offset, records_[slot].text_size };
+}
+
+int SnapshotDocuments::FindSlot(int document_id) const noexcept {
+    const uint32_t* it = std::lower_bound(slots_by_id_, slots_by_id_ + size_, document_id,
+        [this](uint32_t slot, int id) {
+            return records_[slot].document_id < id;
+        });
+    if (it == slots_by_id_ + size_ || records_[*it].document_id != document_id) {
+        return -1;
+    }
+    return static_cast<int>(*it);
+}
+
+int SnapshotDocuments::GetSlotByRank(size_t rank) const noexcept {
+    return static_cast<int>(slots_by_id_[rank]);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "index_snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+// The documents of a loaded index snapshot, read in place from the mapped file: a record
+// per slot, the slots ordered by document id and the texts. Nothing here changes after
+// loading, removed documents are tracked by the server. Copies of the server share the
+// object, so the word frequencies of a document are built on first use and kept for all.
+//
+// Layout in the payload: a section with the document count, then aligned to 8 the records
+// in slot order, the slots in id order as uint32 values and the byte size of the texts as
+// uint64, followed by a section with the texts.
+class SnapshotDocuments {
+public:
+    struct Record {
+        int32_t document_id;
+        int32_t rating;
+        int32_t status;
+        uint32_t text_size;
+        // from the start of the texts
+        uint64_t text_offset;
+    };
+
+    // reads the tables at the position of reader and checks them, the texts are checked
+    // against their checksum only with SnapshotCheck::FULL
+    SnapshotDocuments(std::shared_ptr<const MappedFile> file, SnapshotReader& reader, SnapshotCheck check);
+
+    SnapshotDocuments(const SnapshotDocuments&) = delete;
+    SnapshotDocuments& operator=(const SnapshotDocuments&) = delete;
+
+    size_t Size() const noexcept;
+    const Record& GetRecord(int slot) const noexcept;
+    std::string_view GetText(int slot) const noexcept;
+    // the slot of the document, or -1 if the snapshot has no such document
+    int FindSlot(int document_id) const noexcept;
+    // the slot of the document with the rank-th smallest id
+    int GetSlotByRank(size_t rank) const noexcept;
+
+    // build makes the map from the text of the document, its keys may point into the text
+    template <typename BuildFunction>
+    const std::map<std::string_view, double>& GetWordFrequencies(int slot, BuildFunction build) const;
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    size_t size_ = 0;
+    const Record* records_ = nullptr;
+    const uint32_t* slots_by_id_ = nullptr;
+    const char* texts_ = nullptr;
+
+    mutable std::mutex word_freqs_mutex_;
+    // by slot, the references handed out stay valid as the map grows
+    mutable std::unordered_map<int, std::map<std::string_view, double>> word_freqs_;
+};
+
+template <typename BuildFunction>
+const std::map<std::string_view, double>& SnapshotDocuments::GetWordFrequencies(int slot, BuildFunction build) const {
+    std::lock_guard guard(word_freqs_mutex_);
+    auto it = word_freqs_.find(slot);
+    if (it == word_freqs_.end()) {
+        it = word_freqs_.emplace(slot, build(GetText(slot))).first;
+    }
+    return it->second;
+}
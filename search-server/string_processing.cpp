@@ -1,5 +1,182 @@
 #include "string_processing.h"
 
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STRING_PROCESSING_AVX2 __attribute__((target("avx2")))
+#define STRING_PROCESSING_HAS_SIMD
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define STRING_PROCESSING_AVX2
+#define STRING_PROCESSING_HAS_SIMD
+#endif
+
+namespace
+{
+
+constexpr size_t NO_WORD = std::string_view::npos;
+
+bool IsControlCharacter(char c)
+{
+    return static_cast<unsigned char>(c) < ' ';
+}
+
+int CountTrailingZeros(uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+// Splits the text block by block of up to 32 bytes: bit i of the mask of a block tells
+// whether its byte i is a space, so the words are found with a bit scan per boundary.
+class WordSplitter
+{
+public:
+    WordSplitter(std::string_view text, std::vector<std::string_view>& words)
+        : text_(text)
+        , words_(words)
+    {
+        words_.clear();
+    }
+
+    void AddBlock(size_t block_start, size_t block_size, uint32_t spaces)
+    {
+        const uint32_t block_mask = static_cast<uint32_t>((uint64_t{ 1 } << block_size) - 1);
+        size_t position = 0;
+        while (position < block_size)
+        {
+            const uint32_t rest = block_mask & (~uint32_t{ 0 } << position);
+            const uint32_t boundaries = (word_start_ == NO_WORD ? ~spaces : spaces) & rest;
+            if (boundaries == 0)
+            {
+                return;
+            }
+            position = static_cast<size_t>(CountTrailingZeros(boundaries));
+            if (word_start_ == NO_WORD)
+            {
+                word_start_ = block_start + position;
+            }
+            else
+            {
+                words_.push_back(text_.substr(word_start_, block_start + position - word_start_));
+                word_start_ = NO_WORD;
+            }
+        }
+    }
+
+    // the bytes that do not fill a whole block
+    bool AddScalar(size_t start, bool check_controls)
+    {
+        for (size_t i = start; i < text_.size(); ++i)
+        {
+            if (check_controls && IsControlCharacter(text_[i]))
+            {
+                return false;
+            }
+            if (text_[i] == ' ')
+            {
+                if (word_start_ != NO_WORD)
+                {
+                    words_.push_back(text_.substr(word_start_, i - word_start_));
+                    word_start_ = NO_WORD;
+                }
+            }
+            else if (word_start_ == NO_WORD)
+            {
+                word_start_ = i;
+            }
+        }
+        if (word_start_ != NO_WORD)
+        {
+            words_.push_back(text_.substr(word_start_));
+            word_start_ = NO_WORD;
+        }
+        return true;
+    }
+
+private:
+    std::string_view text_;
+    std::vector<std::string_view>& words_;
+    size_t word_start_ = NO_WORD;
+};
+
+#ifdef STRING_PROCESSING_HAS_SIMD
+
+bool HasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, 7, 0);
+    static const bool has_avx2 = (info[1] & (1 << 5)) != 0;
+#else
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return has_avx2;
+}
+
+// a byte is a control character when min(byte, 0x1F) keeps it unchanged, in unsigned terms
+bool SplitSse2(std::string_view text, std::vector<std::string_view>& words, bool check_controls)
+{
+    WordSplitter splitter(text, words);
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(' ' - 1);
+    size_t block = 0;
+    for (; block + 16 <= text.size(); block += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + block));
+        if (check_controls && _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes)) != 0)
+        {
+            return false;
+        }
+        splitter.AddBlock(block, 16, static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space))));
+    }
+    return splitter.AddScalar(block, check_controls);
+}
+
+STRING_PROCESSING_AVX2
+bool SplitAvx2(std::string_view text, std::vector<std::string_view>& words, bool check_controls)
+{
+    WordSplitter splitter(text, words);
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+    size_t block = 0;
+    for (; block + 32 <= text.size(); block += 32)
+    {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + block));
+        if (check_controls && _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(bytes, last_control), bytes)) != 0)
+        {
+            return false;
+        }
+        splitter.AddBlock(block, 32, static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space))));
+    }
+    return splitter.AddScalar(block, check_controls);
+}
+
+#endif
+
+bool Split(std::string_view text, std::vector<std::string_view>& words, bool check_controls)
+{
+#ifdef STRING_PROCESSING_HAS_SIMD
+    if (HasAvx2())
+    {
+        return SplitAvx2(text, words, check_controls);
+    }
+    return SplitSse2(text, words, check_controls);
+#else
+    return WordSplitter(text, words).AddScalar(0, check_controls);
+#endif
+}
+
+}  // namespace
+
 std::vector<std::string> SplitIntoWords(const std::string& text) 
 {
     std::vector<std::string> words;
@@ -28,15 +205,16 @@ std::vector<std::string> SplitIntoWords(const std::string& text)
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str) 
 {
     std::vector<std::string_view> result;
-    str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
-    const std::string_view::size_type pos_end = std::string_view::npos;
+    SplitIntoWordsView(str, result);
+    return result;
+}
 
-    while (!str.empty())
-    {
-        std::string_view::size_type space = str.find(' ');
-        result.push_back(space == pos_end ? str.substr(0, str.size()) : str.substr(0, space));
-        str.remove_prefix(std::min(str.find_first_not_of(' ', space), str.size()));
-    }
+void SplitIntoWordsView(std::string_view str, std::vector<std::string_view>& result)
+{
+    Split(str, result, false);
+}
 
-    return result;
+bool SplitIntoValidWordsView(std::string_view str, std::vector<std::string_view>& result)
+{
+    return Split(str, result, true);
 }
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
+// refills result, so a reused vector does not allocate once it is large enough
+void SplitIntoWordsView(std::string_view str, std::vector<std::string_view>& result);
+// The same and checks str for control characters in the same pass, vectorized where the CPU
+// allows. Returns false, with result incomplete, if str has a character below ' '.
+bool SplitIntoValidWordsView(std::string_view str, std::vector<std::string_view>& result);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) 
@@ -0,0 +1,103 @@
+#include "term_dictionary.h"
+
+#include <functional>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+TermId TermDictionary::Intern(std::string_view word) {
+    if (const TermId term_id = Find(word); term_id != NO_TERM) {
+        return term_id;
+    }
+    if ((used_entries_ + 1) * 2 > table_.Size()) {
+        Rehash();
+    }
+
+    auto stored_word = std::make_shared<const std::string>(word);
+    TermId term_id = static_cast<TermId>(words_.Size());
+    if (free_ids_.Empty()) {
+        words_.PushBack(stored_word);
+    } else {
+        term_id = free_ids_.Back();
+        free_ids_.PopBack();
+        words_.Mutable(term_id) = stored_word;
+    }
+
+    // a removed entry on the way is reused
+    const size_t mask = table_.Size() - 1;
+    size_t entry = std::hash<std::string_view>{}(word) & mask;
+    while (table_[entry] != NO_TERM && table_[entry] != REMOVED_ENTRY) {
+        entry = (entry + 1) & mask;
+    }
+    if (table_[entry] == NO_TERM) {
+        ++used_entries_;
+    }
+    table_.Mutable(entry) = term_id;
+    return term_id;
+}
+
+void TermDictionary::Release(TermId term_id) {
+    const std::string_view word = GetWord(term_id);
+    if (word.empty()) {
+        return;
+    }
+    table_.Mutable(FindEntry(word)) = REMOVED_ENTRY;
+    words_.Mutable(term_id).reset();
+    free_ids_.PushBack(term_id);
+}
+
+TermId TermDictionary::Find(std::string_view word) const {
+    if (table_.Empty()) {
+        return NO_TERM;
+    }
+    return table_[FindEntry(word)];
+}
+
+std::string_view TermDictionary::GetWord(TermId term_id) const {
+    if (term_id < 0 || static_cast<size_t>(term_id) >= words_.Size()) {
+        throw std::out_of_range("unknown term id "s + std::to_string(term_id));
+    }
+    const auto& word = words_[term_id];
+    return word ? std::string_view{ *word } : std::string_view{};
+}
+
+size_t TermDictionary::Size() const noexcept {
+    return words_.Size();
+}
+
+size_t TermDictionary::FindEntry(std::string_view word) const {
+    const size_t mask = table_.Size() - 1;
+    size_t entry = std::hash<std::string_view>{}(word) & mask;
+    for (TermId term_id = table_[entry]; term_id != NO_TERM; term_id = table_[entry]) {
+        if (term_id != REMOVED_ENTRY && *words_[term_id] == word) {
+            break;
+        }
+        entry = (entry + 1) & mask;
+    }
+    return entry;
+}
+
+void TermDictionary::Rehash() {
+    // at most a quarter full afterwards, the removed entries are dropped
+    const size_t word_count = words_.Size() - free_ids_.Size() + 1;
+    size_t table_size = MIN_TABLE_SIZE;
+    while (table_size < word_count * 4) {
+        table_size *= 2;
+    }
+
+    ChunkedVector<TermId, 10> table;
+    table.Resize(table_size, NO_TERM);
+    const size_t mask = table_size - 1;
+    for (size_t term_id = 0; term_id < words_.Size(); ++term_id) {
+        if (!words_[term_id]) {
+            continue;
+        }
+        size_t entry = std::hash<std::string_view>{}(*words_[term_id]) & mask;
+        while (table[entry] != NO_TERM) {
+            entry = (entry + 1) & mask;
+        }
+        table.Mutable(entry) = static_cast<TermId>(term_id);
+    }
+    table_ = std::move(table);
+    used_entries_ = word_count - 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "chunked_vector.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+using TermId = int;
+
+// Maps every indexed word to a dense integer id. The word strings are immutable
+// and shared between copies of the dictionary, so a view returned by one copy
+// stays valid for as long as any copy that contains the word is alive.
+// Released ids are handed out again to new words.
+//
+// The tables are chunked and shared between copies too, a copy costs a pointer per
+// chunk and a change copies the chunks it touches.
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = -1;
+
+    TermId Intern(std::string_view word);
+    TermId Find(std::string_view word) const;
+    void Release(TermId term_id);
+
+    // empty for a released id
+    std::string_view GetWord(TermId term_id) const;
+    // all ids are below Size(), including the released ones
+    size_t Size() const noexcept;
+
+private:
+    // an entry of a released word, the probing goes on past it
+    static constexpr TermId REMOVED_ENTRY = -2;
+    static constexpr size_t MIN_TABLE_SIZE = 16;
+
+    ChunkedVector<std::shared_ptr<const std::string>, 8> words_;
+    // open addressing with linear probing, NO_TERM marks an empty entry and the size is a power of two
+    ChunkedVector<TermId, 10> table_;
+    // entries not empty, the removed ones included
+    size_t used_entries_ = 0;
+    ChunkedVector<TermId, 10> free_ids_;
+
+    // the entry of the word, or the empty entry ending its probe sequence
+    size_t FindEntry(std::string_view word) const;
+    void Rehash();
+};
@@ -0,0 +1,49 @@
+#include "text_arena.h"
+
+#include <cstring>
+
+TextArena::Chunk::Chunk(size_t capacity)
+    : data(new char[capacity])
+    , capacity(capacity)
+{
+}
+
+std::string_view TextArena::Store(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    char* stored = nullptr;
+    if (text.size() > CHUNK_SIZE / 4) {
+        // a long text gets a chunk of its own size, the open chunk stays open for the next ones
+        chunks_.push_back(std::make_shared<Chunk>(text.size()));
+        stored = Claim(*chunks_.back(), text.size());
+    } else {
+        if (open_chunk_ != nullptr) {
+            stored = Claim(*open_chunk_, text.size());
+        }
+        if (stored == nullptr) {
+            open_chunk_ = std::make_shared<Chunk>(CHUNK_SIZE);
+            chunks_.push_back(open_chunk_);
+            stored = Claim(*open_chunk_, text.size());
+        }
+    }
+    std::memcpy(stored, text.data(), text.size());
+    stored_size_ += text.size();
+    return { stored, text.size() };
+}
+
+size_t TextArena::GetStoredSize() const noexcept {
+    return stored_size_;
+}
+
+char* TextArena::Claim(Chunk& chunk, size_t size) noexcept {
+    // the offset only splits the chunk between the copies, the bytes claimed are written
+    // and read by the copy that claimed them
+    size_t used_size = chunk.used_size.load(std::memory_order_relaxed);
+    do {
+        if (size > chunk.capacity - used_size) {
+            return nullptr;
+        }
+    } while (!chunk.used_size.compare_exchange_weak(used_size, used_size + size, std::memory_order_relaxed));
+    return chunk.data.get() + used_size;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage of document texts in large chunks. A stored text never moves,
+// and copies of the arena share the chunks, so copying a server does not copy the texts.
+// Copies append to the shared last chunk too: each claims its space with an atomic bump
+// of the chunk's offset, so their texts never overlap and no copy starts a chunk of its own.
+class TextArena {
+public:
+    static constexpr size_t CHUNK_SIZE = size_t{ 1 } << 20;
+
+    // the view stays valid while any copy of the arena is alive
+    std::string_view Store(std::string_view text);
+
+    // bytes taken by all the stored texts, the ones of removed documents included
+    size_t GetStoredSize() const noexcept;
+
+private:
+    struct Chunk {
+        explicit Chunk(size_t capacity);
+
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        // the bytes below are claimed by some copy of the arena
+        std::atomic<size_t> used_size{ 0 };
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    // the chunk new texts go to, long texts get chunks of their own
+    std::shared_ptr<Chunk> open_chunk_;
+    size_t stored_size_ = 0;
+
+    // the start of size free bytes in chunk, or nullptr if it has no room
+    static char* Claim(Chunk& chunk, size_t size) noexcept;
+};
@@ -0,0 +1,68 @@
+#include "top_documents.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        // the id only settles full ties, so every evaluation path returns the same documents
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
+        }
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+TopDocuments::TopDocuments(size_t max_count)
+    : max_count_(max_count)
+{
+    heap_.reserve(std::min(max_count_, MAX_RESERVED_COUNT));
+}
+
+void TopDocuments::Add(const Document& document) {
+    if (heap_.size() < max_count_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        return;
+    }
+    if (max_count_ == 0 || !IsMoreRelevant(document, heap_.front())) {
+        return;
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    heap_.back() = document;
+    std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+}
+
+size_t TopDocuments::Size() const noexcept {
+    return heap_.size();
+}
+
+size_t TopDocuments::MaxCount() const noexcept {
+    return max_count_;
+}
+
+bool TopDocuments::IsFull() const noexcept {
+    return heap_.size() == max_count_;
+}
+
+const Document& TopDocuments::Weakest() const {
+    return heap_.front();
+}
+
+std::vector<Document> TopDocuments::Build() && {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    return std::move(heap_);
+}
+
+void TopDocuments::Reset(size_t max_count) {
+    max_count_ = max_count;
+    heap_.clear();
+    heap_.reserve(std::min(max_count_, MAX_RESERVED_COUNT));
+}
+
+void TopDocuments::Build(std::vector<Document>& documents) {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    documents.assign(heap_.begin(), heap_.end());
+    heap_.clear();
+}
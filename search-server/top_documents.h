@@ -0,0 +1,38 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <vector>
+
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const double EPSILON = 1e-6;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+// Keeps the max_count most relevant documents seen so far in a bounded heap
+// whose front is the weakest of them.
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t max_count);
+
+    void Add(const Document& document);
+
+    size_t Size() const noexcept;
+    size_t MaxCount() const noexcept;
+    bool IsFull() const noexcept;
+    const Document& Weakest() const;
+
+    std::vector<Document> Build() &&;
+
+    // the reusable counterparts: Build copies into documents and leaves the top empty
+    void Reset(size_t max_count);
+    void Build(std::vector<Document>& documents);
+
+private:
+    // the heap grows past this on demand, so a large max_count costs nothing up front
+    static constexpr size_t MAX_RESERVED_COUNT = 64;
+
+    size_t max_count_;
+    std::vector<Document> heap_;
+};
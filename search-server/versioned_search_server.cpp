@@ -0,0 +1,78 @@
+#include "versioned_search_server.h"
+
+VersionedSearchServer::VersionedSearchServer(SearchServer search_server)
+{
+    search_server.SetAutoMergeSegments(false);
+    current_ = std::make_shared<const SearchServer>(std::move(search_server));
+    merge_thread_ = std::thread([this]() {
+        MergeSegments();
+    });
+}
+
+VersionedSearchServer::~VersionedSearchServer() {
+    {
+        std::lock_guard guard(merge_mutex_);
+        is_stopping_ = true;
+    }
+    merge_requested_.notify_one();
+    merge_thread_.join();
+}
+
+std::shared_ptr<const SearchServer> VersionedSearchServer::GetSnapshot() const {
+    return std::atomic_load(&current_);
+}
+
+void VersionedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Update([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void VersionedSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    Update([&documents](SearchServer& search_server) {
+        search_server.AddDocuments(std::execution::par, documents);
+    });
+}
+
+void VersionedSearchServer::RemoveDocument(int document_id) {
+    Update([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void VersionedSearchServer::Publish(std::shared_ptr<const SearchServer> search_server) {
+    std::atomic_store(&current_, std::move(search_server));
+    {
+        std::lock_guard guard(merge_mutex_);
+        has_merge_request_ = true;
+    }
+    merge_requested_.notify_one();
+}
+
+void VersionedSearchServer::MergeSegments() {
+    while (true) {
+        {
+            std::unique_lock lock(merge_mutex_);
+            merge_requested_.wait(lock, [this]() { return has_merge_request_ || is_stopping_; });
+            if (is_stopping_) {
+                return;
+            }
+            has_merge_request_ = false;
+        }
+
+        // the merged segment is built from a snapshot, only the swap blocks the writers
+        while (!is_stopping_) {
+            const auto merge = GetSnapshot()->PrepareSegmentMerge();
+            if (!merge) {
+                break;
+            }
+            std::lock_guard guard(update_mutex_);
+            auto next = std::make_shared<SearchServer>(*std::atomic_load(&current_));
+            if (!next->ApplySegmentMerge(*merge)) {
+                // a writer has changed the segments meanwhile, the next request retries
+                break;
+            }
+            std::atomic_store(&current_, std::shared_ptr<const SearchServer>(std::move(next)));
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "search_server.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Lets queries run while the index is being modified. Readers take an immutable
+// snapshot of the current index and query it without any locking; writers apply
+// their changes to a private copy and publish it with a single atomic swap. An
+// old version is freed when the last reader holding its snapshot drops it.
+// Sealed segments are merged by a background thread, off the writers' path.
+class VersionedSearchServer {
+public:
+    explicit VersionedSearchServer(SearchServer search_server);
+    ~VersionedSearchServer();
+
+    VersionedSearchServer(const VersionedSearchServer&) = delete;
+    VersionedSearchServer& operator=(const VersionedSearchServer&) = delete;
+
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+
+    // Runs update on a copy of the current version and publishes the result.
+    // Writers are serialized. The copy shares the sealed segments and the chunks of
+    // the tables with the current version, so it costs the in-memory segment and a
+    // pointer per chunk, and the update copies what it changes. Nothing is published
+    // if update throws.
+    template <typename Updater>
+    void Update(Updater update);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void RemoveDocument(int document_id);
+
+private:
+    std::shared_ptr<const SearchServer> current_;
+    std::mutex update_mutex_;
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_requested_;
+    bool has_merge_request_ = false;
+    std::atomic<bool> is_stopping_{ false };
+    std::thread merge_thread_;
+
+    void Publish(std::shared_ptr<const SearchServer> search_server);
+    void MergeSegments();
+};
+
+template <typename Updater>
+void VersionedSearchServer::Update(Updater update) {
+    std::lock_guard guard(update_mutex_);
+    auto next = std::make_shared<SearchServer>(*std::atomic_load(&current_));
+    update(*next);
+    Publish(std::move(next));
+}